@@ -1,23 +1,130 @@
 #include "AllHaas.h"
 #include "Math.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include <cmath>
 
 namespace dsp
 {
-	AllHaas::AllHaas() :
+	namespace
+	{
+		// the cutoff and feedback ranges of the parameters (see Param.cpp)
+		static constexpr double MinNote = 12., MaxNote = 127.;
+		static constexpr std::array<double, 2> FeedbackExtremesHz = { .1, 20. };
+
+		/* sampleRate, minSnrDb, kernel, isa
+		lowest cutoff (as a note) at which the float32 cascade at full Distance
+		stays within minSnrDb of the double reference, for both feedback extremes.
+		returns something above MaxNote if there is none */
+		double getSinglePrecisionMinNote(double sampleRate, double minSnrDb, AllpassSlopeKernel kernel, Isa isa)
+		{
+			static constexpr int NumSamples = 2048;
+			static constexpr int NumFilters = axiom::NumAllpassFilters;
+
+			std::vector<double> reference(NumSamples);
+			std::vector<float> single(NumSamples);
+
+			const auto isAccurate = [&](double note)
+			{
+				const auto freqHz = math::noteToFreqHz(note);
+				if (freqHz >= sampleRate * .5)
+					return true;
+
+				for (auto fbHz : FeedbackExtremesHz)
+				{
+					AllpassSlope<double> referenceFilter;
+					AllpassSlope<float> singleFilter;
+					referenceFilter.updateParameters(freqHz, fbHz, sampleRate, NumFilters);
+					singleFilter.updateParameters(freqHz, fbHz, sampleRate, NumFilters);
+
+					juce::Random rand(NumSamples);
+					for (auto s = 0; s < NumSamples; ++s)
+					{
+						single[s] = rand.nextFloat() * 2.f - 1.f;
+						reference[s] = static_cast<double>(single[s]);
+					}
+
+					referenceFilter.process(reference.data(), NumSamples);
+					singleFilter.process(single.data(), NumSamples, kernel, isa);
+
+					auto signal = 0., error = 0.;
+					for (auto s = 0; s < NumSamples; ++s)
+					{
+						const auto e = static_cast<double>(single[s]) - reference[s];
+						signal += reference[s] * reference[s];
+						error += e * e;
+					}
+					if (error > 0. && 10. * std::log10(signal / error) < minSnrDb)
+						return false;
+				}
+				return true;
+			};
+
+			// the float32 error mostly comes from poles close to z = 1,
+			// so accuracy improves with the cutoff and the boundary can be bisected
+			if (!isAccurate(MaxNote))
+				return MaxNote + 1.;
+			if (isAccurate(MinNote))
+				return MinNote;
+			auto lo = MinNote, hi = MaxNote;
+			while (hi - lo > 1.)
+			{
+				const auto mid = std::floor((lo + hi) * .5);
+				if (isAccurate(mid))
+					hi = mid;
+				else
+					lo = mid;
+			}
+			return hi;
+		}
+
+		/* sampleRate, minSnrDb, kernel, isa, settings (can be nullptr)
+		the check only depends on these, so it's cached in the settings like the kernel plans
+		and each machine runs it once per sample rate */
+		double getSinglePrecisionMinNote(double sampleRate, double minSnrDb, AllpassSlopeKernel kernel, Isa isa,
+			juce::PropertiesFile* settings)
+		{
+			const auto key = "singlePrecisionMinNote_" + juce::String(juce::roundToInt(sampleRate)) + "_"
+				+ juce::String(juce::roundToInt(minSnrDb)) + "_"
+				+ juce::String(static_cast<int>(kernel)) + "_" + juce::String(static_cast<int>(isa));
+			// notes start at MinNote, so 0 means there is no entry yet
+			if (settings != nullptr)
+			{
+				const auto note = settings->getDoubleValue(key, 0.);
+				if (note >= MinNote)
+					return note;
+			}
+			const auto note = getSinglePrecisionMinNote(sampleRate, minSnrDb, kernel, isa);
+			if (settings != nullptr)
+			{
+				settings->setValue(key, note);
+				settings->saveIfNeeded();
+			}
+			return note;
+		}
+	}
+
+	template<typename Float>
+	AllHaas<Float>::AllHaas() :
 		allpassFilters(),
+		buffer(),
 		sampleRate(1.),
 		cutoffLeft(-1.), cutoffRight(-1.),
 		feedbackLeftHz(-1.), feedbackRightHz(-1.),
 		numFiltersL(-1), numFiltersR(-1)
 	{}
 
-	void AllHaas::prepare(double _sampleRate) noexcept
+	template<typename Float>
+	void AllHaas<Float>::prepare(double _sampleRate) noexcept
 	{
 		sampleRate = _sampleRate;
 		cutoffLeft = -1.;
 	}
 
-	void AllHaas::operator()(float* const* samples,
+	template<typename Float>
+	void AllHaas<Float>::operator()(Float* const* samples,
 		double _cutoffLeft, double _cutoffRight,
 		double _feedbackLeft, double _feedbackRight,
 		int _numFiltersL, int _numFiltersR, int numSamples) noexcept
@@ -26,7 +133,8 @@ namespace dsp
 		processFilters(samples, numSamples);
 	}
 
-	void AllHaas::updateParameters(double _cutoffLeft, double _cutoffRight,
+	template<typename Float>
+	void AllHaas<Float>::updateParameters(double _cutoffLeft, double _cutoffRight,
 		double _feedbackLeftHz, double _feedbackRightHz,
 		int _numFiltersL, int _numFiltersR)
 	{
@@ -51,137 +159,826 @@ namespace dsp
 		allpassFilters.updateParameters(cutoffLeftHz, cutoffRightHz, feedbackLeftHz, feedbackRightHz, sampleRate, numFiltersL, numFiltersR);
 	}
 
-	void AllHaas::processFilters(float* const* samples, int numSamples) noexcept
+	template<typename Float>
+	void AllHaas<Float>::processFilters(Float* const* samples, int numSamples) noexcept
 	{
-		for (auto ch = 0; ch < 2; ++ch)
+		if constexpr (std::is_same<Float, double>::value)
 		{
-			auto smpls = samples[ch];
+			for (auto ch = 0; ch < 2; ++ch)
+				allpassFilters.process(samples[ch], numSamples, ch);
+			return;
+		}
 
-			for (auto s = 0; s < numSamples; ++s)
+		auto dSmpls = buffer.data();
+
+		for (auto ch = 0; ch < 2; ++ch)
+			for (auto s0 = 0; s0 < numSamples; s0 += BlockSize)
 			{
-				const auto dry = smpls[s];
-				const auto wet = allpassFilters(static_cast<double>(dry), ch);
-				smpls[s] = static_cast<float>(wet);
+				auto smpls = &samples[ch][s0];
+				const auto blockSize = std::min(BlockSize, numSamples - s0);
+
+				for (auto s = 0; s < blockSize; ++s)
+					dSmpls[s] = static_cast<double>(smpls[s]);
+				allpassFilters.process(dSmpls, blockSize, ch);
+				for (auto s = 0; s < blockSize; ++s)
+					smpls[s] = static_cast<Float>(dSmpls[s]);
 			}
-		}
 	}
 
+	template struct AllHaas<float>;
+	template struct AllHaas<double>;
+
 	/// ///////////////////////////////////
 
-	AllHaasXFade::AllHaasXFade() :
-		mixer(),
+	template<typename Float>
+	bool AllHaasXFade<Float>::Parameters::operator==(const Parameters& other) const noexcept
+	{
+		return cutoffLeft == other.cutoffLeft &&
+			cutoffRight == other.cutoffRight &&
+			feedbackLeftHz == other.feedbackLeftHz &&
+			feedbackRightHz == other.feedbackRightHz &&
+			numFiltersL == other.numFiltersL &&
+			numFiltersR == other.numFiltersR;
+	}
+
+	template<typename Float>
+	bool AllHaasXFade<Float>::Parameters::isCloseTo(const Parameters& other) const noexcept
+	{
+		const auto isFeedbackClose = [](double a, double b)
+		{
+			return std::abs(a - b) <= FeedbackHysteresis * std::abs(b);
+		};
+		return numFiltersL == other.numFiltersL &&
+			numFiltersR == other.numFiltersR &&
+			std::abs(cutoffLeft - other.cutoffLeft) <= CutoffHysteresis &&
+			std::abs(cutoffRight - other.cutoffRight) <= CutoffHysteresis &&
+			isFeedbackClose(feedbackLeftHz, other.feedbackLeftHz) &&
+			isFeedbackClose(feedbackRightHz, other.feedbackRightHz);
+	}
+
+	template<typename Float>
+	AllHaasXFade<Float>::Track::Track() :
 		filters(),
+		filtersSingle(),
+		convolutions(),
+		params{ -1., -1., -1., -1., -1, -1 },
+		convolving(),
+		single(false)
+	{}
+
+	template<typename Float>
+	AllHaasXFade<Float>::Shared::Worker::Worker() :
+		juce::Thread("AllHaas Tracks"),
+		engines(),
+		pending(false)
+	{}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::Shared::Worker::run()
+	{
+		// the audio thread never signals anything, requestTrack() only raises pending.
+		// only stopThread() wakes it up early
+		while (!threadShouldExit())
+		{
+			if (!pending.exchange(false, std::memory_order_acquire))
+			{
+				wait(1);
+				continue;
+			}
+			for (auto engine : engines)
+				engine->prepareRequestedTrack();
+		}
+	}
+
+	template<typename Float>
+	AllHaasXFade<Float>::Shared::Shared() :
+		planner(),
+		plannerSingle(),
 		sampleRate(1.),
-		cutoffLeft(-1.), cutoffRight(-1.),
-		feedbackLeftHz(-1.), feedbackRightHz(-1.),
-		numFiltersL(-1), numFiltersR(-1)
+		singlePrecisionMinNote(MaxNote + 1.),
+		worker()
 	{}
 
-	void AllHaasXFade::prepare(double _sampleRate, int blockSize)
+	template<typename Float>
+	AllHaasXFade<Float>::Shared::~Shared()
 	{
+		release();
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::Shared::prepare(double _sampleRate, int blockSize, juce::PropertiesFile* settings)
+	{
+		release();
+		worker.engines.clear();
+
 		sampleRate = _sampleRate;
-		mixer.prepare(static_cast<float>(sampleRate), FadeLenMs, blockSize);
-		cutoffLeft = -1.;
+		// the kernels are planned for the blocks they're actually going to get
+		blockSize = std::min(blockSize, BlockSize);
+		planner.prepare(blockSize, settings);
+		if constexpr (std::is_same<Float, float>::value)
+		{
+			plannerSingle.prepare(blockSize, settings);
+			const auto& choice = plannerSingle(axiom::NumAllpassFilters);
+			singlePrecisionMinNote = getSinglePrecisionMinNote(sampleRate, SinglePrecisionMinSnrDb,
+				choice.kernel, choice.isa, settings);
+		}
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::Shared::start()
+	{
+		worker.startThread();
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::Shared::release()
+	{
+		worker.stopThread(1000);
+	}
+
+	template<typename Float>
+	AllHaasXFade<Float>::AllHaasXFade() :
+		mixer(),
+		trackPool(),
+		tracks(),
+		requests(),
+		trackBuffer(), requestBuffer(),
+		trackWriteIdx(0), requestWriteIdx(0), requestReadIdx(0),
+		arena(),
+		lanes(),
+		buffer(nullptr),
+		fadeSamples(),
+		shared(nullptr),
+		coefficientGenerator(),
+		isa(Isa::SSE2),
+		sampleRate(1.),
+		convolutionThresholdDb(DefaultConvolutionThresholdDb),
+		nonRealtime(false),
+		params{ -1., -1., -1., -1., -1, -1 },
+		requested(params),
+		latest(params),
+		modNote(), modFeedbackHz(),
+		modNotes(), modFeedbacksHz(), modA0(), modA1(), modG(), modK(),
+		modulating(),
+		numModulationSteps(0), modulationStep(0),
+		samplesSinceRetune(0), samplesSinceTrack(0), samplesSinceTarget(0), retuneIntervalSamples(0), trackIntervalSamples(0),
+		silentSamples(), channelTails(),
+		linkedSamples(0),
+		skipping(),
+		sharing(false),
+		tapFade(),
+		tapGains(nullptr), tap(nullptr), tapSingle(nullptr),
+		tapStages(), tapTargets(),
+		tapFadesIn(),
+		tapFading(false)
+	{}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::setConvolutionThreshold(double thresholdDb) noexcept
+	{
+		convolutionThresholdDb.store(thresholdDb);
 	}
 
-	/* samples, cutoffLeft, cutoffRight, fbLeftHz,
+	template<typename Float>
+	void AllHaasXFade<Float>::setNonRealtime(bool _nonRealtime) noexcept
+	{
+		nonRealtime = _nonRealtime;
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::prepare(Shared& _shared,
+		double _cutoffLeft, double _cutoffRight,
+		double _fbLeftHz, double _fbRightHz,
+		int _numFiltersL, int _numFiltersR)
+	{
+		shared = &_shared;
+		shared->worker.engines.push_back(this);
+		sampleRate = shared->sampleRate;
+		isa = getNativeIsa();
+		mixer.prepare(static_cast<float>(sampleRate), FadeLenMs);
+		coefficientGenerator.prepare(sampleRate);
+		numModulationSteps = std::max(1, static_cast<int>(std::ceil(
+			static_cast<double>(FadeLenMs) * .001 * sampleRate / static_cast<double>(ModulationBlockSize))));
+
+		// the scratch: lanes, conversion, fade, tap and glide buffers
+		const auto numFadeSamples = static_cast<int>(fadeSamples.size());
+		const auto numRamps = 2 * 6;
+		arena.reset(Arena::getSize<double>(AllpassSlopeLanes<double>::getScratchSize(BlockSize)) +
+			Arena::getSize<double>(BlockSize) +
+			numFadeSamples * Arena::getSize<Float>(BlockSize) +
+			Arena::getSize<Float>(BlockSize) + Arena::getSize<double>(BlockSize) + Arena::getSize<float>(BlockSize) +
+			numRamps * Arena::getSize<double>(numModulationSteps));
+		lanes.prepare(arena.allocate<double>(AllpassSlopeLanes<double>::getScratchSize(BlockSize)));
+		buffer = arena.allocate<double>(BlockSize);
+		for (auto& fadeSmpls : fadeSamples)
+			fadeSmpls = arena.allocate<Float>(BlockSize);
+		tapGains = arena.allocate<Float>(BlockSize);
+		tap = arena.allocate<double>(BlockSize);
+		tapSingle = arena.allocate<float>(BlockSize);
+		for (auto ch = 0; ch < 2; ++ch)
+			for (auto ramp : { &modNotes, &modFeedbacksHz, &modA0, &modA1, &modG, &modK })
+				(*ramp)[ch] = arena.allocate<double>(numModulationSteps);
+		modulationStep = numModulationSteps;
+		retuneIntervalSamples = static_cast<int>(std::ceil(static_cast<double>(RetuneIntervalMs) * .001 * sampleRate));
+		trackIntervalSamples = static_cast<int>(std::ceil(static_cast<double>(TrackIntervalMs) * .001 * sampleRate));
+		samplesSinceRetune = retuneIntervalSamples;
+		samplesSinceTrack = trackIntervalSamples;
+		samplesSinceTarget = retuneIntervalSamples;
+
+		tapFade.inc = msInInc(FadeLenMs, static_cast<float>(sampleRate));
+		tapFading = false;
+		silentSamples = { 0, 0 };
+		linkedSamples = 0;
+		skipping = { false, false };
+		sharing = false;
+
+		for (auto i = 0; i < NumTracks; ++i)
+			tracks[i] = i;
+		trackWriteIdx = NumTracks;
+		trackBuffer.reset(NumTracks + 1);
+		requestWriteIdx = 0;
+		requestReadIdx = 1;
+		requestBuffer.reset(2);
+
+		// the mixer starts out settled on the first track
+		params = { _cutoffLeft, _cutoffRight, _fbLeftHz, _fbRightHz, _numFiltersL, _numFiltersR };
+		requested = params;
+		latest = params;
+		prepareTrack(trackPool[tracks[mixer.idx]], params);
+		updateChannelTails();
+	}
+
+	template<typename Float>
+	double AllHaasXFade<Float>::getTailLength(double _cutoffLeft, double _cutoffRight,
+		double _fbLeftHz, double _fbRightHz,
+		int _numFiltersL, int _numFiltersR, double _sampleRate) noexcept
+	{
+		// convolved channels render the same impulse response, so the cascade speaks for both
+		const auto tailLeft = AllpassSlope<double>::getDecayLength(math::noteToFreqHz(_cutoffLeft),
+			_fbLeftHz, _sampleRate, _numFiltersL, SilenceDb);
+		const auto tailRight = AllpassSlope<double>::getDecayLength(math::noteToFreqHz(_cutoffRight),
+			_fbRightHz, _sampleRate, _numFiltersR, SilenceDb);
+		return std::max(tailLeft, tailRight);
+	}
+
+	/* samples, silent, cutoffLeft, cutoffRight, fbLeftHz,
 	fbRightHz, numFiltersL, numFiltersR, numSamples */
-	void AllHaasXFade::operator()(float* const* samples,
+	template<typename Float>
+	void AllHaasXFade<Float>::operator()(Float* const* samples, const bool* silent,
 		double _cutoffLeft, double _cutoffRight,
 		double _fbLeftHz, double _fbRightHz,
 		int _numFiltersL, int _numFiltersR, int numSamples) noexcept
 	{
-		updateParameters(_cutoffLeft, _cutoffRight, _fbLeftHz, _fbRightHz, _numFiltersL, _numFiltersR);
-		processFilters(samples, numSamples);
+		// whatever the host's block size, the scratch buffers only ever see BlockSize samples,
+		// and the update policy gets to act between blocks
+		for (auto s0 = 0; s0 < numSamples; s0 += BlockSize)
+		{
+			const auto blockSize = std::min(BlockSize, numSamples - s0);
+			const std::array<Float*, 2> block = { &samples[0][s0], &samples[1][s0] };
+			// a shared right channel has to catch up before anything is retuned
+			const Parameters target = { _cutoffLeft, _cutoffRight, _fbLeftHz, _fbRightHz, _numFiltersL, _numFiltersR };
+			if (sharing && shouldRetune(target))
+			{
+				unshareChannels();
+				sharing = false;
+			}
+			const auto tuning = params;
+			updateParameters(_cutoffLeft, _cutoffRight, _fbLeftHz, _fbRightHz, _numFiltersL, _numFiltersR);
+			if (!(params == tuning))
+			{
+				updateChannelTails();
+				silentSamples = { 0, 0 };
+				linkedSamples = 0;
+			}
+			updateSkipping(block.data(), silent, blockSize);
+			samplesSinceRetune = std::min(samplesSinceRetune + blockSize, retuneIntervalSamples);
+			samplesSinceTrack = std::min(samplesSinceTrack + blockSize, trackIntervalSamples);
+			samplesSinceTarget = std::min(samplesSinceTarget + blockSize, retuneIntervalSamples);
+			if (modulationStep == numModulationSteps)
+			{
+				processFilters(block.data(), blockSize);
+				continue;
+			}
+
+			for (auto m0 = 0; m0 < blockSize; m0 += ModulationBlockSize)
+			{
+				if (modulationStep != numModulationSteps)
+					modulate();
+				const std::array<Float*, 2> subBlock = { &block[0][m0], &block[1][m0] };
+				processFilters(subBlock.data(), std::min(ModulationBlockSize, blockSize - m0));
+			}
+		}
 	}
 
-	void AllHaasXFade::updateParameters(double _cutoffLeft, double _cutoffRight,
+	template<typename Float>
+	bool AllHaasXFade<Float>::canModulate(const Parameters& target) const noexcept
+	{
+		const auto& track = trackPool[tracks[mixer.idx]];
+		if (params.cutoffLeft < 0. || track.convolving[0] || track.convolving[1])
+			return false;
+		if (track.single && std::min(target.cutoffLeft, target.cutoffRight) < shared->singlePrecisionMinNote)
+			return false;
+		// the glide goes through every cutoff and feedback in between, so those must be fine as well
+		return target.feedbackLeftHz > 0. && target.feedbackRightHz > 0. &&
+			math::noteToFreqHz(std::max(target.cutoffLeft, target.cutoffRight)) < sampleRate * .5;
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::startTapFade(const Parameters& target) noexcept
+	{
+		auto& track = trackPool[tracks[mixer.idx]];
+		const std::array<int, 2> from = { params.numFiltersL, params.numFiltersR };
+		const std::array<int, 2> to = { target.numFiltersL, target.numFiltersR };
+		for (auto ch = 0; ch < 2; ++ch)
+		{
+			tapStages[ch] = -1;
+			if (from[ch] == to[ch])
+				continue;
+			tapStages[ch] = std::min(from[ch], to[ch]);
+			tapTargets[ch] = to[ch];
+			tapFadesIn[ch] = to[ch] < from[ch];
+			const auto numFilters = std::max(from[ch], to[ch]);
+			if (track.single)
+				track.filtersSingle[ch].setNumFilters(numFilters);
+			else
+				track.filters[ch].setNumFilters(numFilters);
+		}
+		tapFade.gain = 0.f;
+		tapFade.enable();
+		tapFading = true;
+	}
+
+	template<typename Float>
+	template<typename CascadeFloat>
+	void AllHaasXFade<Float>::processCascade(AllpassSlope<CascadeFloat>& cascade, CascadeFloat* smpls,
+		int numSamples, int ch, AllpassSlopeKernel kernel, Isa cascadeIsa) noexcept
+	{
+		if (!tapFading || tapStages[ch] < 0)
+		{
+			cascade.process(smpls, numSamples, kernel, cascadeIsa);
+			return;
+		}
+
+		CascadeFloat* tapSmpls;
+		if constexpr (std::is_same<CascadeFloat, float>::value)
+			tapSmpls = tapSingle;
+		else
+			tapSmpls = tap;
+		cascade.process(smpls, tapSmpls, numSamples, tapStages[ch], kernel, cascadeIsa);
+
+		const auto gains = tapGains;
+		if (tapFadesIn[ch])
+			for (auto s = 0; s < numSamples; ++s)
+				smpls[s] += (tapSmpls[s] - smpls[s]) * static_cast<CascadeFloat>(gains[s]);
+		else
+			for (auto s = 0; s < numSamples; ++s)
+				smpls[s] = tapSmpls[s] + (smpls[s] - tapSmpls[s]) * static_cast<CascadeFloat>(gains[s]);
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::modulate() noexcept
+	{
+		auto& track = trackPool[tracks[mixer.idx]];
+		const auto i = modulationStep++;
+		for (auto ch = 0; ch < 2; ++ch)
+		{
+			if (!modulating[ch])
+				continue;
+			modNote[ch] = modNotes[ch][i];
+			modFeedbackHz[ch] = modFeedbacksHz[ch][i];
+			if (track.single)
+				track.filtersSingle[ch].modulate(modA0[ch][i], modA1[ch][i], modG[ch][i], modK[ch][i]);
+			else
+				track.filters[ch].modulate(modA0[ch][i], modA1[ch][i], modG[ch][i], modK[ch][i]);
+		}
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::updateSkipping(Float* const* samples, const bool* silent, int numSamples) noexcept
+	{
+		const auto& track = trackPool[tracks[mixer.idx]];
+		// only the current track plays, it isn't about to change and no newer target is waiting.
+		// tails are counted from there on, whatever glides and fades left ringing dies away within them
+		const auto settled = !mixer.stillFading() && !tapFading &&
+			modulationStep == numModulationSteps && latest == params;
+		const auto maxSamples = std::numeric_limits<int>::max() - BlockSize;
+
+		// by the time a channel's input has been silent for longer than its tail, so is its output
+		for (auto ch = 0; ch < 2; ++ch)
+		{
+			if (!silent[ch] || !settled)
+				silentSamples[ch] = 0;
+			skipping[ch] = settled && silentSamples[ch] > channelTails[ch];
+			if (silent[ch])
+				silentSamples[ch] = std::min(silentSamples[ch] + numSamples, maxSamples);
+		}
+
+		// the same goes for the difference between two channels that are tuned and fed alike
+		const auto linked = settled && !skipping[0] && !skipping[1] &&
+			params.cutoffLeft == params.cutoffRight &&
+			params.feedbackLeftHz == params.feedbackRightHz &&
+			params.numFiltersL == params.numFiltersR &&
+			track.convolving[0] == track.convolving[1];
+		const auto identical = linked && std::equal(samples[0], samples[0] + numSamples, samples[1]);
+		if (!identical)
+			linkedSamples = 0;
+		const auto share = identical && (sharing || linkedSamples > channelTails[0]);
+		if (sharing && !share)
+			unshareChannels();
+		sharing = share;
+		if (identical)
+			linkedSamples = std::min(linkedSamples + numSamples, maxSamples);
+	}
+
+	template<typename Float>
+	bool AllHaasXFade<Float>::isAsleep() const noexcept
+	{
+		return skipping[0] && skipping[1];
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::updateChannelTails() noexcept
+	{
+		const std::array<double, 2> note = { params.cutoffLeft, params.cutoffRight };
+		const std::array<double, 2> feedbackHz = { params.feedbackLeftHz, params.feedbackRightHz };
+		const std::array<int, 2> numFilters = { params.numFiltersL, params.numFiltersR };
+		for (auto ch = 0; ch < 2; ++ch)
+			channelTails[ch] = static_cast<int>(std::ceil(AllpassSlope<double>::getDecayLength(
+				math::noteToFreqHz(note[ch]), feedbackHz[ch], sampleRate, numFilters[ch], SilenceDb)));
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::unshareChannels() noexcept
+	{
+		auto& track = trackPool[tracks[mixer.idx]];
+		if (track.convolving[1])
+			track.convolutions[1].warmStart(track.convolutions[0]);
+		else if (track.single)
+			track.filtersSingle[1].warmStart(track.filtersSingle[0]);
+		else
+			track.filters[1].warmStart(track.filters[0]);
+	}
+
+	template<typename Float>
+	bool AllHaasXFade<Float>::shouldRetune(const Parameters& target) const noexcept
+	{
+		if (target == params)
+			return false;
+		if (!target.isCloseTo(params))
+			return true;
+		return target == latest && samplesSinceTarget >= retuneIntervalSamples;
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::updateParameters(double _cutoffLeft, double _cutoffRight,
 		double _feedbackLeftHz, double _feedbackRightHz,
 		int _numFiltersL, int _numFiltersR) noexcept
 	{
-		if (mixer.stillFading())
+		const Parameters target = { _cutoffLeft, _cutoffRight, _feedbackLeftHz, _feedbackRightHz, _numFiltersL, _numFiltersR };
+		if (!(target == latest))
+		{
+			latest = target;
+			samplesSinceTarget = 0;
+		}
+		if (!shouldRetune(target))
 			return;
 
-		if (cutoffLeft == _cutoffLeft &&
-			cutoffRight == _cutoffRight &&
-			feedbackLeftHz == _feedbackLeftHz &&
-			feedbackRightHz == _feedbackRightHz &&
-			numFiltersL == _numFiltersL &&
-			numFiltersR == _numFiltersR)
+		// until the policy allows for it, the target is only remembered, so the latest one wins
+		const auto fading = mixer.stillFading() || tapFading;
+		if (canModulate(target))
+		{
+			if (fading || samplesSinceRetune < retuneIntervalSamples)
+				return;
+
+			if (target.numFiltersL != params.numFiltersL || target.numFiltersR != params.numFiltersR)
+				startTapFade(target);
+
+			// restarts from wherever the previous glide got to
+			if (modulationStep == numModulationSteps)
+			{
+				modNote = { params.cutoffLeft, params.cutoffRight };
+				modFeedbackHz = { params.feedbackLeftHz, params.feedbackRightHz };
+			}
+			const std::array<double, 2> note = { target.cutoffLeft, target.cutoffRight };
+			const std::array<double, 2> feedbackHz = { target.feedbackLeftHz, target.feedbackRightHz };
+			const auto numSteps = static_cast<double>(numModulationSteps);
+			for (auto ch = 0; ch < 2; ++ch)
+			{
+				modulating[ch] = note[ch] != modNote[ch] || feedbackHz[ch] != modFeedbackHz[ch];
+				if (!modulating[ch])
+					continue;
+				auto notes = modNotes[ch];
+				auto feedbacksHz = modFeedbacksHz[ch];
+				// linear in pitch, the last step lands on the target exactly
+				for (auto i = 0; i < numModulationSteps; ++i)
+				{
+					const auto x = static_cast<double>(i + 1) / numSteps;
+					notes[i] = modNote[ch] + (note[ch] - modNote[ch]) * x;
+					feedbacksHz[i] = modFeedbackHz[ch] + (feedbackHz[ch] - modFeedbackHz[ch]) * x;
+				}
+				coefficientGenerator(modA0[ch], modA1[ch], modG[ch], modK[ch],
+					notes, feedbacksHz, numModulationSteps);
+			}
+			if (modulating[0] || modulating[1])
+				modulationStep = 0;
+			samplesSinceRetune = 0;
+			params = target;
 			return;
+		}
 
-		cutoffLeft = _cutoffLeft;
-		cutoffRight = _cutoffRight;
-		feedbackLeftHz = _feedbackLeftHz;
-		feedbackRightHz = _feedbackRightHz;
-		numFiltersL = _numFiltersL;
-		numFiltersR = _numFiltersR;
+		// a new track. offline renders prepare it in place,
+		// otherwise the worker is asked for one and the current track keeps playing until it's there
+		const auto inPlace = nonRealtime;
+		if (!inPlace)
+			requestTrack(target);
+		if (fading || samplesSinceTrack < trackIntervalSamples)
+			return;
 
-		const auto cutoffLeftHz = math::noteToFreqHz(cutoffLeft);
-		const auto cutoffRightHz = math::noteToFreqHz(cutoffRight);
+		const auto next = (mixer.idx + 1) % NumTracks;
+		if (inPlace)
+			prepareTrack(trackPool[tracks[next]], target);
+		else
+		{
+			const auto fresh = trackBuffer.fetch(tracks[next]);
+			if (fresh < 0)
+				return;
+			tracks[next] = fresh;
+		}
 
+		// under automation the track can be for a slightly older target,
+		// the next call takes care of the rest
+		auto& track = trackPool[tracks[next]];
+		const auto fadeLenMs = warmStart(track, trackPool[tracks[mixer.idx]]);
+		modulationStep = numModulationSteps;
+		samplesSinceTrack = 0;
+		params = track.params;
 		mixer.init();
-		filters[mixer.idx].updateParameters(cutoffLeftHz, cutoffRightHz, feedbackLeftHz, feedbackRightHz, sampleRate, numFiltersL, numFiltersR);
-		filters[mixer.idx].reset();
+		mixer.setLength(static_cast<float>(sampleRate), fadeLenMs);
 	}
 
-	void AllHaasXFade::processFilters(float* const* samples, int numSamples) noexcept
+	template<typename Float>
+	float AllHaasXFade<Float>::warmStart(Track& track, Track& from) noexcept
 	{
-		auto sumSamples = mixer.getSamples(0);
-		{
-			auto& track = mixer[0];
-			if (track.isEnabled())
-			{
-				track.synthesizeGainValues(sumSamples[2], numSamples);
-				auto& filter = filters[0];
+		const std::array<double, 2> note = { track.params.cutoffLeft, track.params.cutoffRight };
+		const std::array<double, 2> feedbackHz = { track.params.feedbackLeftHz, track.params.feedbackRightHz };
+		const std::array<int, 2> numFilters = { track.params.numFiltersL, track.params.numFiltersR };
+		// where the playing track is now, it might have glided since it was prepared
+		const std::array<double, 2> fromNote = { params.cutoffLeft, params.cutoffRight };
+		const std::array<double, 2> fromFeedbackHz = { params.feedbackLeftHz, params.feedbackRightHz };
+		const std::array<int, 2> fromNumFilters = { params.numFiltersL, params.numFiltersR };
+		const auto wasPlaying = params.cutoffLeft >= 0.;
 
-				for (auto ch = 0; ch < 2; ++ch)
-				{
-					const auto smpls = samples[ch];
-					auto xSmpls = sumSamples[ch];
+		// how long numStages cascade stages take to fill up from silence:
+		// each one delays its cutoff's neighbourhood by 2q / (pi * freq)
+		const auto getFillLengthMs = [&](int ch, int numStages)
+		{
+			const auto freqHz = math::noteToFreqHz(note[ch]);
+			return static_cast<float>(1000. * numStages * 2. * feedbackHz[ch] / (math::Pi * freqHz));
+		};
 
-					for (auto s = 0; s < numSamples; ++s)
-					{
-						const auto dry = smpls[s];
-						const auto wet = filter(static_cast<double>(dry), ch);
-						xSmpls[s] = static_cast<float>(wet);
-					}
-				}
+		auto fadeLenMs = MinFadeLenMs;
+		for (auto ch = 0; ch < 2; ++ch)
+		{
+			auto warm = false;
+			if (wasPlaying && track.convolving[ch] && from.convolving[ch])
+				warm = track.convolutions[ch].warmStart(from.convolutions[ch]);
+			else if (wasPlaying && !track.convolving[ch] && !from.convolving[ch])
+			{
+				// precision switches end up here
+				if (track.single && from.single)
+					track.filtersSingle[ch].warmStart(from.filtersSingle[ch]);
+				else if (track.single)
+					track.filtersSingle[ch].warmStart(from.filters[ch]);
+				else if (from.single)
+					track.filters[ch].warmStart(from.filtersSingle[ch]);
+				else
+					track.filters[ch].warmStart(from.filters[ch]);
+				warm = true;
+			}
 
-				track.copy(sumSamples, sumSamples, 2, numSamples);
+			auto lengthMs = FadeLenMs;
+			if (warm)
+			{
+				// nothing has to fill up, the fade only hides the step between both tunings
+				const auto octaves = std::max(std::abs(note[ch] - fromNote[ch]) / 12.,
+					std::abs(std::log2(feedbackHz[ch] / fromFeedbackHz[ch])));
+				lengthMs = MinFadeLenMs + (FadeLenMs - MinFadeLenMs) * static_cast<float>(std::min(1., octaves));
+				if (!track.convolving[ch])
+					lengthMs = std::max(lengthMs, getFillLengthMs(ch, numFilters[ch] - fromNumFilters[ch]));
 			}
+			else if (track.convolving[ch])
+				lengthMs = static_cast<float>(1000. * track.convolutions[ch].getLength() / sampleRate);
 			else
-				for (auto ch = 0; ch < 2; ++ch)
-					SIMD::clear(sumSamples[ch], numSamples);
+				lengthMs = getFillLengthMs(ch, numFilters[ch]);
+			fadeLenMs = std::max(fadeLenMs, std::min(lengthMs, FadeLenMs));
+		}
+		return fadeLenMs;
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::requestTrack(const Parameters& target) noexcept
+	{
+		if (target == requested)
+			return;
+		requests[requestWriteIdx] = target;
+		requestWriteIdx = requestBuffer.publish(requestWriteIdx);
+		requested = target;
+		shared->worker.pending.store(true, std::memory_order_release);
+	}
+
+	template<typename Float>
+	bool AllHaasXFade<Float>::prepareRequestedTrack() noexcept
+	{
+		const auto idx = requestBuffer.fetch(requestReadIdx);
+		if (idx < 0)
+			return false;
+		requestReadIdx = idx;
+		prepareTrack(trackPool[trackWriteIdx], requests[requestReadIdx]);
+		trackWriteIdx = trackBuffer.publish(trackWriteIdx);
+		return true;
+	}
+
+	template<typename Float>
+	void AllHaasXFade<Float>::prepareTrack(Track& track, const Parameters& target) noexcept
+	{
+		track.params = target;
+		const auto cutoffLeftHz = math::noteToFreqHz(target.cutoffLeft);
+		const auto cutoffRightHz = math::noteToFreqHz(target.cutoffRight);
+
+		// switching precision only ever happens on a new track, so the crossfade hides it
+		track.single = std::min(target.cutoffLeft, target.cutoffRight) >= shared->singlePrecisionMinNote;
+
+		// convolve whichever channel's impulse response is cheaper than its cascade.
+		// the convolution runs in the host's precision, its cost was measured by the planner of the same type
+		const KernelPlanner<Float>* convolutionPlanner;
+		if constexpr (std::is_same<Float, float>::value)
+			convolutionPlanner = &shared->plannerSingle;
+		else
+			convolutionPlanner = &shared->planner;
+
+		const std::array<double, 2> cutoffHz = { cutoffLeftHz, cutoffRightHz };
+		const std::array<double, 2> feedbackHz = { target.feedbackLeftHz, target.feedbackRightHz };
+		const std::array<int, 2> numFilters = { target.numFiltersL, target.numFiltersR };
+		const auto thresholdDb = convolutionThresholdDb.load();
+		for (auto ch = 0; ch < 2; ++ch)
+		{
+			const auto cascadeCost = track.single ? shared->plannerSingle.getCost(numFilters[ch]) :
+				shared->planner.getCost(numFilters[ch]);
+			const auto maxLength = convolutionPlanner->getMaxConvolutionLength(cascadeCost);
+			auto& convolution = track.convolutions[ch];
+			track.convolving[ch] = convolution.updateParameters(cutoffHz[ch], feedbackHz[ch],
+				sampleRate, numFilters[ch], thresholdDb, maxLength);
+			convolution.reset();
 		}
 
-		for (auto i = 1; i < NumTracks; ++i)
+		if (track.single)
 		{
-			auto& track = mixer[i];
-			if (track.isEnabled())
-			{
-				auto xSamples = mixer.getSamples(i);
-				track.synthesizeGainValues(xSamples[2], numSamples);
-				auto& filter = filters[i];
+			track.filtersSingle.updateParameters(cutoffLeftHz, cutoffRightHz, target.feedbackLeftHz, target.feedbackRightHz,
+				sampleRate, target.numFiltersL, target.numFiltersR);
+			track.filtersSingle.reset();
+		}
+		else
+		{
+			track.filters.updateParameters(cutoffLeftHz, cutoffRightHz, target.feedbackLeftHz, target.feedbackRightHz,
+				sampleRate, target.numFiltersL, target.numFiltersR);
+			track.filters.reset();
+		}
+	}
 
+	template<typename Float>
+	void AllHaasXFade<Float>::processFilters(Float* const* samples, int numSamples) noexcept
+	{
+		static_assert(NumTracks * 2 <= AllpassSlopeLanes<double>::NumLanes);
+		std::array<AllpassSlope<double>*, AllpassSlopeLanes<double>::NumLanes> cascades;
+		std::array<Float*, AllpassSlopeLanes<double>::NumLanes> lanesSamples;
+		std::array<int, AllpassSlopeLanes<double>::NumLanes> channels;
+		auto numLanes = 0;
+		const auto& kernels = getKernels<Float>(isa);
+
+		// tap fades never overlap with track crossfades, so only the current track is playing
+		if (tapFading)
+			tapFade.synthesizeGainValues(tapGains, numSamples, kernels);
+
+		// the current track runs in place, the one fading out runs on a copy of the input.
+		// the current track goes last, so its convolutions can't overwrite anyone else's input
+		const auto fadeGains = &fadeSamples[2 * (NumTracks - 1)];
+		auto numFadingOut = 0;
+		for (auto j = 1; j <= NumTracks; ++j)
+		{
+			const auto i = (mixer.idx + j) % NumTracks;
+			auto trackSamples = samples;
+			if (i != mixer.idx)
+			{
+				if (!mixer[i].isEnabled())
+					continue;
+				trackSamples = &fadeSamples[2 * numFadingOut];
+				++numFadingOut;
 				for (auto ch = 0; ch < 2; ++ch)
-				{
-					const auto smpls = samples[ch];
-					auto xSmpls = xSamples[ch];
+					SIMD::copy(trackSamples[ch], samples[ch], numSamples);
+			}
 
-					for (auto s = 0; s < numSamples; ++s)
+			auto& track = trackPool[tracks[i]];
+			for (auto ch = 0; ch < 2; ++ch)
+			{
+				if (skipping[ch] || (sharing && ch == 1))
+					continue;
+				const auto smpls = trackSamples[ch];
+				if (track.convolving[ch])
+				{
+					track.convolutions[ch].process(smpls, numSamples, isa);
+					continue;
+				}
+				if constexpr (std::is_same<Float, float>::value)
+					if (track.single)
 					{
-						const auto dry = smpls[s];
-						const auto wet = filter(static_cast<double>(dry), ch);
-						xSmpls[s] = static_cast<float>(wet);
+						auto& cascade = track.filtersSingle[ch];
+						const auto& choice = shared->plannerSingle(cascade.getNumFilters());
+						processCascade(cascade, smpls, numSamples, ch, choice.kernel, choice.isa);
+						continue;
 					}
-				}
+				cascades[numLanes] = &track.filters[ch];
+				lanesSamples[numLanes] = smpls;
+				channels[numLanes] = ch;
+				++numLanes;
+			}
+		}
 
-				track.add(sumSamples, xSamples, 2, numSamples);
+		// the planner knows whether packing the cascades into vector lanes beats running each of them
+		// on its own kernel, it depends on the isa's width and on how far the Distances are apart
+		auto packed = false;
+		if (!tapFading && numLanes > 1)
+		{
+			auto maxFilters = 0;
+			auto separateCost = 0.;
+			for (auto l = 0; l < numLanes; ++l)
+			{
+				maxFilters = std::max(maxFilters, cascades[l]->getNumFilters());
+				separateCost += shared->planner.getCost(cascades[l]->getNumFilters());
 			}
+			packed = shared->planner.getLanesCost(numLanes, maxFilters) < separateCost;
 		}
+		if (packed)
+			lanes(cascades.data(), lanesSamples.data(), lanesSamples.data(), numLanes, numSamples, isa);
+		else if constexpr (std::is_same<Float, double>::value)
+			for (auto l = 0; l < numLanes; ++l)
+			{
+				const auto& choice = shared->planner(cascades[l]->getNumFilters());
+				processCascade(*cascades[l], lanesSamples[l], numSamples, channels[l], choice.kernel, choice.isa);
+			}
+		else
+		{
+			auto dSmpls = buffer;
+			for (auto l = 0; l < numLanes; ++l)
+			{
+				auto smpls = lanesSamples[l];
+				for (auto s = 0; s < numSamples; ++s)
+					dSmpls[s] = static_cast<double>(smpls[s]);
+				const auto& choice = shared->planner(cascades[l]->getNumFilters());
+				processCascade(*cascades[l], dSmpls, numSamples, channels[l], choice.kernel, choice.isa);
+				for (auto s = 0; s < numSamples; ++s)
+					smpls[s] = static_cast<Float>(dSmpls[s]);
+			}
+		}
+
+		if (sharing)
+			SIMD::copy(samples[1], samples[0], numSamples);
 
+		// the faded out Distances stop running
+		if (tapFading && !tapFade.isFading())
+		{
+			auto& track = trackPool[tracks[mixer.idx]];
+			for (auto ch = 0; ch < 2; ++ch)
+				if (tapStages[ch] >= 0)
+				{
+					if (track.single)
+						track.filtersSingle[ch].setNumFilters(tapTargets[ch]);
+					else
+						track.filters[ch].setNumFilters(tapTargets[ch]);
+				}
+			tapFading = false;
+		}
+
+		// one pass per track, and none at all outside of crossfades
+		auto& current = mixer[mixer.idx];
+		if (numFadingOut == 0 && !current.isFading())
+			return;
+		current.synthesizeGainValues(fadeGains[mixer.idx], numSamples, kernels);
 		for (auto ch = 0; ch < 2; ++ch)
-			SIMD::copy(samples[ch], sumSamples[ch], numSamples);
+			kernels.multiply(samples[ch], samples[ch], fadeGains[mixer.idx], numSamples);
+		numFadingOut = 0;
+		for (auto j = 1; j < NumTracks; ++j)
+		{
+			const auto i = (mixer.idx + j) % NumTracks;
+			if (!mixer[i].isEnabled())
+				continue;
+			mixer[i].synthesizeGainValues(fadeGains[i], numSamples, kernels);
+			const auto trackSamples = &fadeSamples[2 * numFadingOut];
+			++numFadingOut;
+			for (auto ch = 0; ch < 2; ++ch)
+				kernels.addWithMultiply(samples[ch], trackSamples[ch], fadeGains[i], numSamples);
+		}
 	}
+
+	template struct AllHaasXFade<float>;
+	template struct AllHaasXFade<double>;
 }
\ No newline at end of file
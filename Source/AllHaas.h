@@ -1,24 +1,39 @@
 #pragma once
+#include <atomic>
+#include <vector>
 #include "Allpass.h"
+#include "AllpassCoefficients.h"
+#include "AllpassConvolution.h"
+#include "AllpassLanes.h"
+#include "Arena.h"
+#include "Planner.h"
+#include "TripleBuffer.h"
 #include "XFade.h"
 
 namespace dsp
 {
+	/*
+	Float is the host's sample type, the cascades always run in double
+	*/
+	template<typename Float>
 	struct AllHaas
 	{
+		static constexpr int BlockSize = 64;
+
 		AllHaas();
 
 		void prepare(double) noexcept;
 
 		/* samples, cutoffLeft, cutoffRight, fbLeftHz,
 		fbRightHz, numFiltersL, numFiltersR, numSamples */
-		void operator()(float* const*,
+		void operator()(Float* const*,
 			double, double,
 			double, double,
 			int, int, int) noexcept;
 
 	protected:
-		AllpassStereoSlope allpassFilters;
+		AllpassStereoSlope<double> allpassFilters;
+		std::array<double, BlockSize> buffer;
 		double sampleRate;
 
 		double cutoffLeft, cutoffRight, feedbackLeftHz, feedbackRightHz;
@@ -28,39 +43,270 @@ namespace dsp
 		void updateParameters(double, double, double, double, int, int);
 
 		/* samples, numSamples */
-		void processFilters(float* const*, int) noexcept;
+		void processFilters(Float* const*, int) noexcept;
 	};
 
+	/*
+	Float is the host's sample type.
+	cascades run in double, except for tracks of a float host whose cutoffs are
+	high enough for the float32 engine to stay within SinglePrecisionMinSnrDb
+	of the double reference at Distance axiom::NumAllpassFilters
+	(measured once per machine and sample rate, then cached in the settings).
+	channels whose truncated impulse response is cheaper to convolve than
+	their cascade is to run are convolved instead (see AllpassSlopeConvolution).
+	cutoff and feedback changes glide within the current track's cascades (see AllpassSlope::modulate),
+	Distance changes fade between two taps of them (see AllpassSlope::process).
+	only changes of precision or convolution start a crossfade to the other track,
+	which picks up the state of the one it fades in from where it can (see warmStart),
+	so the fade only has to be as long as the retuning it hides.
+	tracks are prepared on a worker thread and handed over through a TripleBuffer,
+	the audio thread keeps playing the current one until the new one is ready.
+	the audio thread only raises an atomic flag to ask for one, it never signals the worker,
+	which checks the flag every millisecond. all engines of a processor share it (see Shared).
+	under automation, changes below the hysteresis wait until the target has held still for
+	RetuneIntervalMs, glides are retargeted at most every RetuneIntervalMs and
+	new tracks start at most every TrackIntervalMs.
+	whatever arrives in between, or during a crossfade, is coalesced: the latest value wins
+	*/
+	template<typename Float>
 	struct AllHaasXFade
 	{
 		static constexpr int NumTracks = 2;
 		static constexpr float FadeLenMs = 40.f;
+		// crossfades between nearly identical tunings of warm started tracks
+		static constexpr float MinFadeLenMs = 5.f;
+		static constexpr double SinglePrecisionMinSnrDb = 90.;
+		static constexpr double DefaultConvolutionThresholdDb = -120.;
+		// host blocks are processed in chunks of up to BlockSize, so all scratch fits in L1
+		static constexpr int BlockSize = 256;
+		// samples between retunes of a gliding cascade
+		static constexpr int ModulationBlockSize = 32;
+		static_assert(BlockSize % ModulationBlockSize == 0);
+		// changes smaller than these are inaudible: cutoff in semitones, feedback relative to itself
+		static constexpr double CutoffHysteresis = .05, FeedbackHysteresis = .01;
+		// so both cascades run at most half of the time while Distance is automated
+		static constexpr float RetuneIntervalMs = 10.f, TrackIntervalMs = 2.f * FadeLenMs;
+		// below this, input is silence and impulse responses have died away
+		static constexpr double SilenceDb = -120.;
+		// SilenceDb as the power of a sample, 10^(SilenceDb / 10)
+		static constexpr double Silence = 1e-12;
+
+		/*
+		what all engines of a processor have in common: the kernel plans, the float32 accuracy check
+		and the worker that prepares their tracks, so each of them is measured and run only once
+		*/
+		struct Shared
+		{
+			Shared();
+
+			~Shared();
+
+			/* sampleRate, blockSize, settings (can be nullptr)
+			stops the worker and lets go of the engines, they have to be prepared again.
+			settings caches the kernel plans (see KernelPlanner) and the float32 accuracy check.
+			blockSize is only a hint for the planner, blocks of any size can be processed */
+			void prepare(double, int, juce::PropertiesFile*);
+
+			/* starts the worker for the engines prepared since prepare() */
+			void start();
+
+			/* stops the worker until the next start, the engines must not outlive it running */
+			void release();
+
+		private:
+			/* prepares the tracks the engines ask for, and sleeps in between */
+			struct Worker :
+				public juce::Thread
+			{
+				Worker();
+
+				void run() override;
+
+				std::vector<AllHaasXFade*> engines;
+				// raised by the engines' requestTrack, lowered by the worker before it looks at them
+				std::atomic<bool> pending;
+			};
+
+			KernelPlanner<double> planner;
+			KernelPlanner<float> plannerSingle;
+			double sampleRate, singlePrecisionMinNote;
+			Worker worker;
+
+			friend struct AllHaasXFade;
+		};
 
 		AllHaasXFade();
 
-		/* sampleRate, blockSize */
-		void prepare(double, int);
+		/* thresholdDb
+		energy left in the tail where impulse responses are truncated, relative to all of it.
+		applies from the next parameter change on */
+		void setConvolutionThreshold(double) noexcept;
 
-		/* samples, cutoffLeft, cutoffRight, fbLeftHz,
-		fbRightHz, numFiltersL, numFiltersR, numSamples */
-		void operator()(float* const*,
+		/* nonRealtime
+		offline renders prepare new tracks in place instead of waiting for the worker,
+		so they sound the same no matter how fast they run */
+		void setNonRealtime(bool) noexcept;
+
+		/* shared, cutoffLeft, cutoffRight, fbLeftHz, fbRightHz, numFiltersL, numFiltersR
+		after shared.prepare() and before shared.start(), which hands the engine to the worker.
+		the first track is tuned to the parameters right here, so the audio thread never has to */
+		void prepare(Shared&,
+			double, double,
+			double, double,
+			int, int);
+
+		/* cutoffLeft, cutoffRight, fbLeftHz, fbRightHz, numFiltersL, numFiltersR, sampleRate
+		samples until the longer channel's impulse response has decayed by SilenceDb */
+		static double getTailLength(double, double, double, double, int, int, double) noexcept;
+
+		/* samples, silent, cutoffLeft, cutoffRight, fbLeftHz,
+		fbRightHz, numFiltersL, numFiltersR, numSamples
+		silent tells for each channel whether its input stays below Silence,
+		the caller has to look at the samples anyway */
+		void operator()(Float* const*, const bool*,
 			double, double,
 			double, double,
 			int, int, int) noexcept;
 
+		/* whether both channels have been silent for longer than their tails
+		since anything last glided, faded or was retuned, so the output is silent too.
+		it stays that way for as long as the input is silent and the parameters don't change */
+		bool isAsleep() const noexcept;
+
 	protected:
-		XFadeMixer<NumTracks, true> mixer;
-		std::array<AllpassStereoSlope, NumTracks> filters;
+		/* what a track is tuned to */
+		struct Parameters
+		{
+			double cutoffLeft, cutoffRight, feedbackLeftHz, feedbackRightHz;
+			int numFiltersL, numFiltersR;
+
+			bool operator==(const Parameters&) const noexcept;
+
+			/* other
+			whether the difference is below CutoffHysteresis and FeedbackHysteresis */
+			bool isCloseTo(const Parameters&) const noexcept;
+		};
+
+		/* the cascades and convolutions of one of the mixer's tracks */
+		struct Track
+		{
+			Track();
+
+			AllpassStereoSlope<double> filters;
+			AllpassStereoSlope<float> filtersSingle;
+			std::array<AllpassSlopeConvolution<Float>, 2> convolutions;
+			Parameters params;
+			std::array<bool, 2> convolving;
+			bool single;
+		};
+
+		XFadeMixer<NumTracks, true, Float> mixer;
+		// the mixer's tracks, the one the worker fills and the one waiting in trackBuffer
+		std::array<Track, NumTracks + 2> trackPool;
+		std::array<int, NumTracks> tracks;
+		// parameters the audio thread wants tracks for
+		std::array<Parameters, 3> requests;
+		TripleBuffer trackBuffer, requestBuffer;
+		int trackWriteIdx, requestWriteIdx, requestReadIdx;
+		// every scratch buffer below is carved from it in prepare
+		Arena arena;
+		AllpassSlopeLanes<double> lanes;
+		double* buffer;
+		// the input of the tracks fading out, then one gain lane per track
+		std::array<Float*, 3 * NumTracks - 2> fadeSamples;
+		Shared* shared;
+		AllpassCoefficientGenerator coefficientGenerator;
+		Isa isa;
 		double sampleRate;
+		std::atomic<double> convolutionThresholdDb;
+		bool nonRealtime;
 
-		double cutoffLeft, cutoffRight, feedbackLeftHz, feedbackRightHz;
-		int numFiltersL, numFiltersR;
+		// what the current track is tuned to (or gliding towards), what was last requested
+		// and the latest target
+		Parameters params, requested, latest;
+
+		// cutoff (as a note) and feedback each channel of the current track is at while it glides,
+		// and the glide itself, one set of coefficients per ModulationBlockSize step
+		std::array<double, 2> modNote, modFeedbackHz;
+		std::array<double*, 2> modNotes, modFeedbacksHz, modA0, modA1, modG, modK;
+		std::array<bool, 2> modulating;
+		int numModulationSteps, modulationStep;
+
+		// since the last glide and the last new track started, and since the target last changed
+		int samplesSinceRetune, samplesSinceTrack, samplesSinceTarget, retuneIntervalSamples, trackIntervalSamples;
+
+		// content-aware skipping, decided per block while nothing glides or fades: channels whose input
+		// has been silent for longer than their tail are skipped, and identical inputs through identical
+		// settings only run the left channel once the right one's state has caught up with it
+		std::array<int, 2> silentSamples, channelTails;
+		int linkedSamples;
+		std::array<bool, 2> skipping;
+		bool sharing;
+
+		// the Distance fade of each channel of the current track: the cascade runs the longer
+		// of both Distances, the tap is the shorter one. tapStages is -1 for channels that don't fade
+		typename XFadeMixer<NumTracks, true, Float>::Track tapFade;
+		Float* tapGains;
+		double* tap;
+		float* tapSingle;
+		std::array<int, 2> tapStages, tapTargets;
+		std::array<bool, 2> tapFadesIn;
+		bool tapFading;
 
 		void updateParameters(double, double,
 			double, double,
 			int, int) noexcept;
 
-		void processFilters(float* const*, int) noexcept;
+		/* target
+		whether it's worth retuning to: it's beyond the hysteresis, or it's the latest target
+		and has held still for RetuneIntervalMs, so automation always ends up on the exact value */
+		bool shouldRetune(const Parameters&) const noexcept;
+
+		/* params
+		lets the worker prepare a track early, so it's there once the policy allows for it */
+		void requestTrack(const Parameters&) noexcept;
+
+		/* track, params
+		tunes the track from scratch, it must not be playing */
+		void prepareTrack(Track&, const Parameters&) noexcept;
+
+		/* track, from
+		lets the track carry on from the state of the one it's about to fade in from.
+		returns the crossfade's length in ms: short between similar tunings of warm started channels,
+		as long as a cold channel takes to fill up otherwise */
+		float warmStart(Track&, Track&) noexcept;
+
+		/* worker side: prepares the latest request, if there is a new one */
+		bool prepareRequestedTrack() noexcept;
+
+		/* params
+		whether the current track can glide to these instead of fading to the other one */
+		bool canModulate(const Parameters&) const noexcept;
+
+		/* params
+		fades the current track's cascades to the new Distances */
+		void startTapFade(const Parameters&) noexcept;
+
+		/* cascade, smpls, numSamples, ch, kernel, isa
+		runs the cascade, and mixes in the tap while the channel's Distance fades */
+		template<typename CascadeFloat>
+		void processCascade(AllpassSlope<CascadeFloat>&, CascadeFloat*, int, int, AllpassSlopeKernel, Isa) noexcept;
+
+		/* one ModulationBlockSize step of the glide */
+		void modulate() noexcept;
+
+		/* samples, silent, numSamples
+		decides which channels of the block are skipped or shared.
+		the inputs are only compared while sharing them is an option */
+		void updateSkipping(Float* const*, const bool*, int) noexcept;
+
+		/* how long each channel of params takes to decay by SilenceDb */
+		void updateChannelTails() noexcept;
+
+		/* the right channel takes over the state of the left one it was sharing */
+		void unshareChannels() noexcept;
+
+		void processFilters(Float* const*, int) noexcept;
 	};
 }
 
@@ -1,9 +1,116 @@
 #include "Allpass.h"
+#include <algorithm>
 #include <cmath>
+#include <utility>
 #include "Math.h"
 
 namespace dsp
 {
+	namespace
+	{
+		/* a0, a1, z1, z2, smpl */
+		template<typename Float>
+		inline Float stage(Float a0, Float a1, Float& z1, Float& z2, Float x) noexcept
+		{
+			const auto y = a0 * x + z1;
+			z1 = a1 * (x - y) + z2;
+			z2 = x - a0 * y;
+			return y;
+		}
+
+		/* a0, a1, z1, z2, smpls, numSamples, stages
+		the stages' states are kept in registers for the whole block,
+		each sample goes through all of them before the next one comes in */
+		template<typename Float, int... Stages>
+		inline void group([[maybe_unused]] Float a0, [[maybe_unused]] Float a1,
+			[[maybe_unused]] Float* z1, [[maybe_unused]] Float* z2, Float* smpls, int numSamples,
+			std::integer_sequence<int, Stages...>) noexcept
+		{
+			if constexpr (sizeof...(Stages) != 0)
+			{
+				Float s1[] = { z1[Stages]... };
+				Float s2[] = { z2[Stages]... };
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					auto x = smpls[s];
+					((x = stage(a0, a1, s1[Stages], s2[Stages], x)), ...);
+					smpls[s] = x;
+				}
+				((z1[Stages] = s1[Stages], z2[Stages] = s2[Stages]), ...);
+			}
+		}
+
+		/* a0, a1, z1, z2, smpls, numSamples */
+		template<typename Float, int NumStages>
+		void group(Float a0, Float a1, Float* z1, Float* z2, Float* smpls, int numSamples) noexcept
+		{
+			group(a0, a1, z1, z2, smpls, numSamples, std::make_integer_sequence<int, NumStages>());
+		}
+
+		template<typename Float, int... Is>
+		constexpr auto makeGroups(std::integer_sequence<int, Is...>) noexcept
+		{
+			using Group = void(*)(Float, Float, Float*, Float*, Float*, int) noexcept;
+			return std::array<Group, sizeof...(Is)>{ &group<Float, Is>... };
+		}
+
+		// every number of stages up to UnrollSize
+		template<typename Float>
+		static constexpr auto Groups = makeGroups<Float>(
+			std::make_integer_sequence<int, AllpassSlope<Float>::UnrollSize + 1>());
+
+		/* g, k
+		maps the state (ic1eq, ic2eq) of a TPT state variable allpass, y = x - 2k * band,
+		to the state (z1, z2) of the TDF-II stage with the same transfer function:
+		g = tan(pi * freq / fs), k = 1 / q. row-major 2x2 */
+		std::array<double, 4> getStateVariableToTDF2(double g, double k) noexcept
+		{
+			const auto c1 = 1. / (1. + g * (g + k));
+			const auto c2 = g * c1;
+			const auto c3 = g * c2;
+			const auto a1 = 2. * (g * g - 1.) * c1;
+
+			// both forms agree on the zero-input response, which pins the mapping down:
+			// z1 is the next output, z2 is what z1 turns into once that output is taken
+			std::array<double, 4> t;
+			for (auto col = 0; col < 2; ++col)
+			{
+				double s1 = col == 0 ? 1. : 0.;
+				double s2 = col == 1 ? 1. : 0.;
+				const auto tick = [&]()
+				{
+					const auto v1 = c1 * s1 - c2 * s2;
+					const auto v2 = s2 + c2 * s1 - c3 * s2;
+					s1 = 2. * v1 - s1;
+					s2 = 2. * v2 - s2;
+					return -2. * k * v1;
+				};
+				const auto y0 = tick();
+				const auto y1 = tick();
+				t[col] = y0;
+				t[2 + col] = y1 + a1 * y0;
+			}
+			return t;
+		}
+
+		/* gFrom, kFrom, gTo, kTo
+		TDF-II state -> state variable state under the old coefficients -> TDF-II state under the new ones.
+		row-major 2x2 */
+		std::array<double, 4> getStateTransfer(double gFrom, double kFrom, double gTo, double kTo) noexcept
+		{
+			const auto from = getStateVariableToTDF2(gFrom, kFrom);
+			const auto to = getStateVariableToTDF2(gTo, kTo);
+			const auto det = from[0] * from[3] - from[1] * from[2];
+			const auto i0 = from[3] / det, i1 = -from[1] / det;
+			const auto i2 = -from[2] / det, i3 = from[0] / det;
+			return
+			{
+				to[0] * i0 + to[1] * i2, to[0] * i1 + to[1] * i3,
+				to[2] * i0 + to[3] * i2, to[2] * i1 + to[3] * i3
+			};
+		}
+	}
+
 	///
 
 	AllpassFirstOrder::AllpassFirstOrder() :
@@ -36,18 +143,21 @@ namespace dsp
 
 	///
 
-	AllpassTransposedDirectFormII::AllpassTransposedDirectFormII() :
-		a0(0.), a1(0.), a2(0.), b1(0.), b2(0.),
-		z1(0.), z2(0.)
+	template<typename Float>
+	AllpassTransposedDirectFormII<Float>::AllpassTransposedDirectFormII() :
+		a0(0), a1(0), a2(0), b1(0), b2(0),
+		z1(0), z2(0)
 	{}
 
-	void AllpassTransposedDirectFormII::reset() noexcept
+	template<typename Float>
+	void AllpassTransposedDirectFormII<Float>::reset() noexcept
 	{
-		z1 = 0.;
-		z2 = 0.;
+		z1 = 0;
+		z2 = 0;
 	}
 
-	void AllpassTransposedDirectFormII::copyFrom(const AllpassTransposedDirectFormII& other) noexcept
+	template<typename Float>
+	void AllpassTransposedDirectFormII<Float>::copyFrom(const AllpassTransposedDirectFormII& other) noexcept
 	{
 		a0 = other.a0;
 		a1 = other.a1;
@@ -56,20 +166,32 @@ namespace dsp
 		b2 = other.b2;
 	}
 
-	void AllpassTransposedDirectFormII::updateParameters(double freq, double q, double fs) noexcept
+	template<typename Float>
+	void AllpassTransposedDirectFormII<Float>::updateParameters(double freq, double q, double fs) noexcept
+	{
+		double _a0, _a1;
+		getCoefficients(_a0, _a1, freq, q, fs);
+		a0 = static_cast<Float>(_a0);
+		a1 = static_cast<Float>(_a1);
+		a2 = 1;
+		b1 = a1;
+		b2 = a0;
+	}
+
+	template<typename Float>
+	void AllpassTransposedDirectFormII<Float>::getCoefficients(double& _a0, double& _a1,
+		double freq, double q, double fs) noexcept
 	{
 		const auto k = std::tan(math::Pi * freq / fs);
 		const auto kk = k * k;
 		const auto kq = k / q;
 		const auto norm = 1. / (1. + kq + kk);
-		a0 = (1. - kq + kk) * norm;
-		a1 = 2. * (kk - 1.) * norm;
-		a2 = 1.;
-		b1 = a1;
-		b2 = a0;
+		_a0 = (1. - kq + kk) * norm;
+		_a1 = 2. * (kk - 1.) * norm;
 	}
 
-	double AllpassTransposedDirectFormII::operator()(double x) noexcept
+	template<typename Float>
+	Float AllpassTransposedDirectFormII<Float>::operator()(Float x) noexcept
 	{
 		auto y = a0 * x + z1;
 		z1 = a1 * x - b1 * y + z2;
@@ -77,6 +199,26 @@ namespace dsp
 		return y;
 	}
 
+	template<typename Float>
+	void AllpassTransposedDirectFormII<Float>::process(Float* smpls, int numSamples) noexcept
+	{
+		const auto _a0 = a0, _a1 = a1, _a2 = a2, _b1 = b1, _b2 = b2;
+		auto _z1 = z1, _z2 = z2;
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			const auto x = smpls[s];
+			const auto y = _a0 * x + _z1;
+			_z1 = _a1 * x - _b1 * y + _z2;
+			_z2 = _a2 * x - _b2 * y;
+			smpls[s] = y;
+		}
+		z1 = _z1;
+		z2 = _z2;
+	}
+
+	template struct AllpassTransposedDirectFormII<float>;
+	template struct AllpassTransposedDirectFormII<double>;
+
 	///
 
 	Allpass2ndOrderDirectFormI::Allpass2ndOrderDirectFormI() :
@@ -214,43 +356,193 @@ namespace dsp
 
 	///
 
-	AllpassSlope::AllpassSlope() :
-		allpasses(),
+	template<typename Float>
+	AllpassSlope<Float>::AllpassSlope() :
+		z1(),
+		z2(),
+		a0(0), a1(0),
+		g(0.), k(1.),
+		stateSpace(),
 		numFilters(axiom::NumAllpassFilters)
 	{}
 
-	void AllpassSlope::reset() noexcept
+	template<typename Float>
+	void AllpassSlope<Float>::reset() noexcept
 	{
+		z1.fill(0);
+		z2.fill(0);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::updateParameters(double freq, double q, double fs, int _numFilters) noexcept
+	{
+		setNumFilters(_numFilters);
+		double _a0, _a1;
+		AllpassTransposedDirectFormII<double>::getCoefficients(_a0, _a1, freq, q, fs);
+		setCoefficients(_a0, _a1, std::tan(math::Pi * freq / fs), 1. / q);
+	}
+
+	template<typename Float>
+	double AllpassSlope<Float>::getDecayLength(double freq, double q, double fs, int _numFilters, double thresholdDb) noexcept
+	{
+		if (_numFilters <= 0)
+			return 0.;
+		double _a0, _a1;
+		AllpassTransposedDirectFormII<double>::getCoefficients(_a0, _a1, freq, q, fs);
+		// the slowest pole: a complex pair has a radius of sqrt(a0), real ones are the roots of z^2 + a1 z + a0
+		const auto discriminant = _a1 * _a1 - 4. * _a0;
+		const auto radius = discriminant < 0. ? std::sqrt(_a0) : .5 * (std::abs(_a1) + std::sqrt(discriminant));
+		const auto r = std::min(std::max(radius, 1e-9), 1. - 1e-12);
+		// every stage delays what's around that pole by up to (1 + r) / (1 - r) samples,
+		// after the last one it dies away like a single stage
+		const auto groupDelay = (1. + r) / (1. - r);
+		const auto level = thresholdDb * std::log(10.) / 20.;
+		return _numFilters * groupDelay + level / std::log(r);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::setCoefficients(double _a0, double _a1, double _g, double _k) noexcept
+	{
+		a0 = static_cast<Float>(_a0);
+		a1 = static_cast<Float>(_a1);
+		g = _g;
+		k = _k;
+		stateSpace.updateParameters(_a0, _a1);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::modulate(double _a0, double _a1, double _g, double _k) noexcept
+	{
+		const auto m = getStateTransfer(g, k, _g, _k);
+		setCoefficients(_a0, _a1, _g, _k);
+		const auto m0 = static_cast<Float>(m[0]), m1 = static_cast<Float>(m[1]);
+		const auto m2 = static_cast<Float>(m[2]), m3 = static_cast<Float>(m[3]);
+
 		for (auto i = 0; i < numFilters; ++i)
-			allpasses[i].reset();
+		{
+			const auto s1 = z1[i], s2 = z2[i];
+			z1[i] = m0 * s1 + m1 * s2;
+			z2[i] = m2 * s1 + m3 * s2;
+		}
 	}
 
-	void AllpassSlope::updateParameters(double freq, double q, double fs, int _numFilters) noexcept
+	template<typename Float>
+	template<typename OtherFloat>
+	void AllpassSlope<Float>::warmStart(const AllpassSlope<OtherFloat>& other) noexcept
 	{
-		numFilters = _numFilters;
-		allpasses[0].updateParameters(freq, q, fs);
-		for (auto i = 1; i < numFilters; ++i)
-			allpasses[i].copyFrom(allpasses[0]);
+		// the same mapping as modulate(), only across two cascades
+		const auto m = getStateTransfer(other.g, other.k, g, k);
+		const auto numShared = std::min(numFilters, other.numFilters);
+		for (auto i = 0; i < numShared; ++i)
+		{
+			const auto s1 = static_cast<double>(other.z1[i]), s2 = static_cast<double>(other.z2[i]);
+			z1[i] = static_cast<Float>(m[0] * s1 + m[1] * s2);
+			z2[i] = static_cast<Float>(m[2] * s1 + m[3] * s2);
+		}
+		for (auto i = numShared; i < numFilters; ++i)
+			z1[i] = z2[i] = 0;
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::copyFrom(const AllpassSlope& other, int _numFilters) noexcept
+	{
+		setNumFilters(_numFilters);
+		a0 = other.a0;
+		a1 = other.a1;
+		g = other.g;
+		k = other.k;
+		stateSpace.copyFrom(other.stateSpace);
 	}
 
-	void AllpassSlope::copyFrom(const AllpassSlope& other, int _numFilters) noexcept
+	template<typename Float>
+	void AllpassSlope<Float>::setNumFilters(int _numFilters) noexcept
 	{
+		for (auto i = numFilters; i < _numFilters; ++i)
+			z1[i] = z2[i] = 0;
 		numFilters = _numFilters;
-		for (auto i = 0; i < numFilters; ++i)
-			allpasses[i].copyFrom(other.allpasses[0]);
 	}
 
-	double AllpassSlope::operator()(double x) noexcept
+	template<typename Float>
+	Float AllpassSlope<Float>::operator()(Float x) noexcept
 	{
-		auto y = x;
-		for (auto i = 0; i < numFilters; ++i)
+		process(&x, 1);
+		return x;
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::process(Float* smpls, int numSamples) noexcept
+	{
+		processStageMajor(smpls, numSamples, 0, numFilters);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::processStageMajor(Float* smpls, int numSamples, int first, int numStages) noexcept
+	{
+		const auto end = first + numStages;
+		auto i = first;
+		for (; i + UnrollSize <= end; i += UnrollSize)
+			Groups<Float>[UnrollSize](a0, a1, &z1[i], &z2[i], smpls, numSamples);
+		Groups<Float>[end - i](a0, a1, &z1[i], &z2[i], smpls, numSamples);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::processWavefront(Float* smpls, int numSamples, Isa isa) noexcept
+	{
+		const auto numProcessed = getKernels<Float>(isa).wavefront(smpls, numSamples,
+			a0, a1, z1.data(), z2.data(), numFilters);
+		processStageMajor(smpls, numSamples, numProcessed, numFilters - numProcessed);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::process(Float* smpls, int numSamples, Kernel kernel, Isa isa) noexcept
+	{
+		switch (kernel)
 		{
-			auto& allpass = allpasses[i];
-			y = allpass(y);
+		case Kernel::Wavefront: return processWavefront(smpls, numSamples, isa);
+		case Kernel::StateSpace: return processStateSpace(smpls, numSamples, isa);
+		default: return process(smpls, numSamples);
 		}
-		return y;
 	}
 
+	template<typename Float>
+	void AllpassSlope<Float>::process(Float* smpls, Float* tap, int numSamples, int tapStage,
+		Kernel kernel, Isa isa) noexcept
+	{
+		processStages(smpls, numSamples, 0, tapStage, kernel, isa);
+		std::copy(smpls, smpls + numSamples, tap);
+		processStages(smpls, numSamples, tapStage, numFilters - tapStage, kernel, isa);
+	}
+
+	template<typename Float>
+	void AllpassSlope<Float>::processStages(Float* smpls, int numSamples, int first, int numStages,
+		Kernel kernel, Isa isa) noexcept
+	{
+		const auto& kernels = getKernels<Float>(isa);
+		auto numProcessed = 0;
+		if (kernel == Kernel::Wavefront)
+			numProcessed = kernels.wavefront(smpls, numSamples, a0, a1, &z1[first], &z2[first], numStages);
+		else if (kernel == Kernel::StateSpace &&
+			AllpassBlockStateSpace<Float>::getRelativeCost(numSamples, kernels.vectorWidth) < 1.)
+		{
+			kernels.stateSpace(smpls, numSamples, stateSpace, a0, a1, &z1[first], &z2[first], numStages);
+			numProcessed = numStages;
+		}
+		processStageMajor(smpls, numSamples, first + numProcessed, numStages - numProcessed);
+	}
+
+	template<typename Float>
+	int AllpassSlope<Float>::getNumFilters() const noexcept
+	{
+		return numFilters;
+	}
+
+	template struct AllpassSlope<float>;
+	template struct AllpassSlope<double>;
+	template void AllpassSlope<float>::warmStart(const AllpassSlope<float>&) noexcept;
+	template void AllpassSlope<float>::warmStart(const AllpassSlope<double>&) noexcept;
+	template void AllpassSlope<double>::warmStart(const AllpassSlope<float>&) noexcept;
+	template void AllpassSlope<double>::warmStart(const AllpassSlope<double>&) noexcept;
+
 	///
 
 	AllpassSlopeStereo::AllpassSlopeStereo() :
@@ -285,19 +577,22 @@ namespace dsp
 
 	///
 
-	AllpassStereoSlope::AllpassStereoSlope() :
+	template<typename Float>
+	AllpassStereoSlope<Float>::AllpassStereoSlope() :
 		allpasses()
 	{
 	}
 
-	void AllpassStereoSlope::reset() noexcept
+	template<typename Float>
+	void AllpassStereoSlope<Float>::reset() noexcept
 	{
 		allpasses[0].reset();
 		allpasses[1].reset();
 	}
 
 	/* freqHzL freqHzR, qHzL, qHzR, sampleRate, numFiltersLeft, numFiltersRight */
-	void AllpassStereoSlope::updateParameters(double freqHzL, double freqHzR,
+	template<typename Float>
+	void AllpassStereoSlope<Float>::updateParameters(double freqHzL, double freqHzR,
 		double qHzL, double qHzR, double sampleRate,
 		int numFiltersL, int numFiltersR) noexcept
 	{
@@ -306,9 +601,26 @@ namespace dsp
 	}
 
 	/* smpl, ch */
-	double AllpassStereoSlope::operator()(double smpl, int ch) noexcept
+	template<typename Float>
+	Float AllpassStereoSlope<Float>::operator()(Float smpl, int ch) noexcept
 	{
 		auto& allpass = allpasses[ch];
 		return allpass(smpl);
 	}
+
+	/* smpls, numSamples, ch */
+	template<typename Float>
+	void AllpassStereoSlope<Float>::process(Float* smpls, int numSamples, int ch) noexcept
+	{
+		allpasses[ch].process(smpls, numSamples);
+	}
+
+	template<typename Float>
+	AllpassSlope<Float>& AllpassStereoSlope<Float>::operator[](int ch) noexcept
+	{
+		return allpasses[ch];
+	}
+
+	template struct AllpassStereoSlope<float>;
+	template struct AllpassStereoSlope<double>;
 }
\ No newline at end of file
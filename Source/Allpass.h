@@ -1,6 +1,7 @@
 #pragma once
 #include <array>
 #include "Axioms.h"
+#include "Dispatch.h"
 
 namespace dsp
 {
@@ -27,7 +28,9 @@ namespace dsp
 	/*
 	Canonical Form II 2nd Order (TDF-II)
 	bad modulation
+	coefficients are always computed in double, then rounded to Float
 	*/
+	template<typename Float>
 	struct AllpassTransposedDirectFormII
 	{
 		AllpassTransposedDirectFormII();
@@ -39,11 +42,18 @@ namespace dsp
 		/* freqHz, qHz, sampleRate */
 		void updateParameters(double, double, double) noexcept;
 
-		double operator()(double) noexcept;
+		/* a0, a1, freqHz, qHz, sampleRate
+		a2 = 1, b1 = a1 and b2 = a0 */
+		static void getCoefficients(double&, double&, double, double, double) noexcept;
+
+		Float operator()(Float) noexcept;
+
+		/* smpls, numSamples */
+		void process(Float*, int) noexcept;
 
 	private:
-		double a0, a1, a2, b1, b2;
-		double z1, z2;
+		Float a0, a1, a2, b1, b2;
+		Float z1, z2;
 	};
 
 	/*
@@ -115,14 +125,59 @@ namespace dsp
 		double operator()(double, int) noexcept;
 
 	private:
-		std::array<AllpassTransposedDirectFormII, 2> filters;
+		std::array<AllpassTransposedDirectFormII<double>, 2> filters;
+	};
+
+	/*
+	block state-space form of one AllpassTransposedDirectFormII stage:
+	over Order samples, y = h * x + o1 * z1 + o2 * z2
+	and the state at the end of the block is A^Order * z + g * x.
+	hPad is the impulse response h, preceded by Order zeros
+	all stages of an AllpassSlope share it, since they share their coefficients
+	*/
+	template<typename Float>
+	struct AllpassBlockStateSpace
+	{
+		static constexpr int Order = 16;
+
+		AllpassBlockStateSpace();
+
+		void copyFrom(const AllpassBlockStateSpace&) noexcept;
+
+		/* a0, a1 */
+		void updateParameters(double, double) noexcept;
+
+		/* numSamples, vectorWidth
+		estimated cpu cost relative to the direct recurrence, < 1 means it's cheaper */
+		static double getRelativeCost(int, int) noexcept;
+
+		std::array<Float, 2 * Order> hPad;
+		std::array<Float, Order> o1, o2, g1, g2;
+		Float aK11, aK12, aK21, aK22;
+	};
+
+	template<typename Float>
+	struct AllpassSlopeLanes;
+
+	/* shared by both precisions of AllpassSlope */
+	enum class AllpassSlopeKernel
+	{
+		StageMajor,
+		Wavefront,
+		StateSpace,
+		NumKernels
 	};
 
 	/*
 	axiom::NumAllpassFilters channels of AllpassTransposedDirectFormII filters
+	all stages share one set of coefficients,
+	their states are kept in contiguous arrays so the kernels only touch state
 	*/
+	template<typename Float>
 	struct AllpassSlope
 	{
+		using Kernel = AllpassSlopeKernel;
+
 		AllpassSlope();
 
 		void reset() noexcept;
@@ -133,12 +188,80 @@ namespace dsp
 		/* other, numFilters */
 		void copyFrom(const AllpassSlope&, int) noexcept;
 
+		/* freqHz, qHz, sampleRate, numFilters, thresholdDb
+		estimates how many samples the impulse response takes to decay thresholdDb (negative) below its peak */
+		static double getDecayLength(double, double, double, int, double) noexcept;
+
+		/* a0, a1, g, k (see AllpassCoefficientGenerator)
+		retunes without interrupting the signal: the states are carried over as if the stages were
+		TPT state variable allpasses, which stay stable and click-free under coefficient changes.
+		between calls the TDF-II kernels run as usual, so it's meant to be called every few samples */
+		void modulate(double, double, double, double) noexcept;
+
+		/* other
+		takes over other's state, mapped onto this cascade's coefficients like in modulate(),
+		so a freshly tuned cascade doesn't have to fill up from silence.
+		stages other doesn't have start from silence */
+		template<typename OtherFloat>
+		void warmStart(const AllpassSlope<OtherFloat>&) noexcept;
+
 		/* smpl */
-		double operator()(double) noexcept;
+		Float operator()(Float) noexcept;
+
+		/* smpls, numSamples
+		runs the whole block through UnrollSize stages at a time before moving on to the next ones */
+		void process(Float*, int) noexcept;
+
+		/* smpls, numSamples, isa
+		wavefront: consecutive stages share a vector, each one lane a sample behind the previous.
+		the pipeline is filled and drained within the block, so there is no added latency */
+		void processWavefront(Float*, int, Isa) noexcept;
+
+		/* smpls, numSamples, isa
+		time-parallel: each stage is applied to Order samples at a time with
+		AllpassBlockStateSpace's precomputed matrices instead of the per-sample recurrence.
+		falls back to process() if that would cost more than the direct recurrence */
+		void processStateSpace(Float*, int, Isa) noexcept;
+
+		/* smpls, numSamples, kernel, isa */
+		void process(Float*, int, Kernel, Isa) noexcept;
+
+		/* smpls, tap, numSamples, tapStage, kernel, isa
+		like above, but tap also gets the output of the first tapStage stages,
+		so two Distances can be heard from one cascade */
+		void process(Float*, Float*, int, int, Kernel, Isa) noexcept;
+
+		/* numFilters
+		changes Distance in place. stages that weren't running start from silence */
+		void setNumFilters(int) noexcept;
+
+		int getNumFilters() const noexcept;
+
+		/* stages the stage-major kernel runs per pass over the block, fully unrolled.
+		more of them run out of registers for their states */
+		static constexpr int UnrollSize = 8;
 
 	private:
-		std::array<AllpassTransposedDirectFormII, axiom::NumAllpassFilters> allpasses;
+		alignas(64) std::array<Float, axiom::NumAllpassFilters> z1;
+		alignas(64) std::array<Float, axiom::NumAllpassFilters> z2;
+		Float a0, a1;
+		// the same coefficients in state variable form, see modulate()
+		double g, k;
+		AllpassBlockStateSpace<Float> stateSpace;
 		int numFilters;
+
+		/* a0, a1, g, k */
+		void setCoefficients(double, double, double, double) noexcept;
+
+		/* smpls, numSamples, firstStage, numStages
+		the stage-major kernel, UnrollSize stages per pass */
+		void processStageMajor(Float*, int, int, int) noexcept;
+
+		/* smpls, numSamples, firstStage, numStages, kernel, isa */
+		void processStages(Float*, int, int, int, Kernel, Isa) noexcept;
+
+		friend struct AllpassSlopeLanes<Float>;
+		template<typename> friend struct AllpassSlope;
 	};
 
 	/*
@@ -164,6 +287,7 @@ namespace dsp
 	/*
 	2 channels of AllpassSlope filters
 	*/
+	template<typename Float>
 	struct AllpassStereoSlope
 	{
 		AllpassStereoSlope();
@@ -174,9 +298,15 @@ namespace dsp
 		void updateParameters(double, double, double, double, double, int, int) noexcept;
 
 		/* smpl, ch */
-		double operator()(double, int) noexcept;
+		Float operator()(Float, int) noexcept;
+
+		/* smpls, numSamples, ch */
+		void process(Float*, int, int) noexcept;
+
+		/* ch */
+		AllpassSlope<Float>& operator[](int) noexcept;
 
 	private:
-		std::array<AllpassSlope, 2> allpasses;
+		std::array<AllpassSlope<Float>, 2> allpasses;
 	};
 }
\ No newline at end of file
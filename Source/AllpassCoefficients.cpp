@@ -0,0 +1,57 @@
+#include "AllpassCoefficients.h"
+#include <algorithm>
+#include <cmath>
+#include "Math.h"
+
+namespace dsp
+{
+	AllpassCoefficientGenerator::AllpassCoefficientGenerator() :
+		table(),
+		maxNote(MinNote)
+	{}
+
+	void AllpassCoefficientGenerator::prepare(double sampleRate)
+	{
+		const auto nyquistNote = 69. + 12. * std::log2(MaxFreqRatio * sampleRate / 440.);
+		maxNote = std::max(MinNote, std::min(MaxNote, nyquistNote));
+
+		const auto numSteps = static_cast<int>(std::ceil((maxNote - MinNote) * StepsPerNote));
+		table.resize(numSteps + 4);
+		for (auto i = 0; i < static_cast<int>(table.size()); ++i)
+		{
+			const auto note = MinNote + static_cast<double>(i - 1) / static_cast<double>(StepsPerNote);
+			table[i] = std::tan(math::Pi * math::noteToFreqHz(note) / sampleRate);
+		}
+	}
+
+	void AllpassCoefficientGenerator::operator()(double* a0, double* a1, double* g, double* k,
+		const double* notes, const double* qs, int numPairs) const noexcept
+	{
+		const auto tab = table.data() + 1;
+		for (auto n = 0; n < numPairs; ++n)
+		{
+			const auto x = (std::min(std::max(notes[n], MinNote), maxNote) - MinNote) * StepsPerNote;
+			const auto i = static_cast<int>(x);
+			const auto t = x - static_cast<double>(i);
+
+			// 4 point lagrange
+			const auto tp1 = t + 1., tm1 = t - 1., tm2 = t - 2.;
+			const auto wm1 = -t * tm1 * tm2 * (1. / 6.);
+			const auto w0 = tp1 * tm1 * tm2 * .5;
+			const auto w1 = -tp1 * t * tm2 * .5;
+			const auto w2 = tp1 * t * tm1 * (1. / 6.);
+			g[n] = wm1 * tab[i - 1] + w0 * tab[i] + w1 * tab[i + 1] + w2 * tab[i + 2];
+		}
+
+		// same as AllpassTransposedDirectFormII::getCoefficients
+		for (auto n = 0; n < numPairs; ++n)
+		{
+			const auto kk = g[n] * g[n];
+			const auto kq = g[n] / qs[n];
+			const auto norm = 1. / (1. + kq + kk);
+			a0[n] = (1. - kq + kk) * norm;
+			a1[n] = 2. * (kk - 1.) * norm;
+			k[n] = 1. / qs[n];
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "AllpassConvolution.h"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cmath>
+#include "Math.h"
+
+namespace dsp
+{
+	template<typename Float>
+	RealFFT<Float>::RealFFT() :
+		wRe(), wIm(), wImInverse(),
+		tRe(), tIm(), re(), im(),
+		bitReversed()
+	{
+		auto numBits = 0;
+		while ((1 << numBits) < Half)
+			++numBits;
+		for (auto i = 0; i < Half; ++i)
+		{
+			auto r = 0;
+			for (auto b = 0; b < numBits; ++b)
+				r |= ((i >> b) & 1) << (numBits - 1 - b);
+			bitReversed[i] = r;
+
+			const auto t = -math::Tau * static_cast<double>(i) / static_cast<double>(Size);
+			tRe[i] = static_cast<Float>(std::cos(t));
+			tIm[i] = static_cast<Float>(std::sin(t));
+		}
+
+		for (auto halfLen = 1; halfLen < Half; halfLen <<= 1)
+			for (auto k = 0; k < halfLen; ++k)
+			{
+				const auto w = -math::Pi * static_cast<double>(k) / static_cast<double>(halfLen);
+				wRe[halfLen - 1 + k] = static_cast<Float>(std::cos(w));
+				wIm[halfLen - 1 + k] = static_cast<Float>(std::sin(w));
+				wImInverse[halfLen - 1 + k] = -wIm[halfLen - 1 + k];
+			}
+	}
+
+	template<typename Float>
+	void RealFFT<Float>::transform(const Kernels<Float>& kernels, bool inverse) noexcept
+	{
+		const auto twiddlesIm = inverse ? wImInverse.data() : wIm.data();
+		for (auto halfLen = 1; halfLen < Half; halfLen <<= 1)
+			kernels.butterflies(re.data(), im.data(), &wRe[halfLen - 1], &twiddlesIm[halfLen - 1], Half, halfLen);
+	}
+
+	template<typename Float>
+	void RealFFT<Float>::forward(const Float* smpls, Float* outRe, Float* outIm, const Kernels<Float>& kernels) noexcept
+	{
+		// even samples into re, odd ones into im, in bit-reversed order
+		for (auto i = 0; i < Half; ++i)
+		{
+			re[bitReversed[i]] = smpls[2 * i];
+			im[bitReversed[i]] = smpls[2 * i + 1];
+		}
+		transform(kernels, false);
+
+		// split the spectra of the even and odd samples again and combine them
+		const auto half = static_cast<Float>(.5);
+		for (auto k = 0; k <= Half; ++k)
+		{
+			const auto k0 = k % Half, k1 = (Half - k) % Half;
+			const auto eRe = (re[k0] + re[k1]) * half;
+			const auto eIm = (im[k0] - im[k1]) * half;
+			const auto oRe = (im[k0] + im[k1]) * half;
+			const auto oIm = (re[k1] - re[k0]) * half;
+			const auto w0 = k < Half ? tRe[k] : static_cast<Float>(-1);
+			const auto w1 = k < Half ? tIm[k] : static_cast<Float>(0);
+			outRe[k] = eRe + oRe * w0 - oIm * w1;
+			outIm[k] = eIm + oRe * w1 + oIm * w0;
+		}
+	}
+
+	template<typename Float>
+	void RealFFT<Float>::inverse(const Float* inRe, const Float* inIm, Float* smpls, const Kernels<Float>& kernels) noexcept
+	{
+		const auto half = static_cast<Float>(.5);
+		for (auto k = 0; k < Half; ++k)
+		{
+			const auto k1 = Half - k;
+			const auto eRe = (inRe[k] + inRe[k1]) * half;
+			const auto eIm = (inIm[k] - inIm[k1]) * half;
+			const auto dRe = (inRe[k] - inRe[k1]) * half;
+			const auto dIm = (inIm[k] + inIm[k1]) * half;
+			// odd spectrum = difference / twiddle
+			const auto oRe = dRe * tRe[k] + dIm * tIm[k];
+			const auto oIm = dIm * tRe[k] - dRe * tIm[k];
+			re[bitReversed[k]] = eRe - oIm;
+			im[bitReversed[k]] = eIm + oRe;
+		}
+		transform(kernels, true);
+
+		const auto scale = static_cast<Float>(1) / static_cast<Float>(Half);
+		for (auto i = 0; i < Half; ++i)
+		{
+			smpls[2 * i] = re[i] * scale;
+			smpls[2 * i + 1] = im[i] * scale;
+		}
+	}
+
+	template struct RealFFT<float>;
+	template struct RealFFT<double>;
+
+	///
+
+	template<typename Float>
+	AllpassSlopeConvolution<Float>::AllpassSlopeConvolution() :
+		fft(),
+		cascade(),
+		impulseResponse(),
+		head(),
+		spectraRe(), spectraIm(),
+		inputRe(), inputIm(),
+		accRe(), accIm(),
+		history(), window(),
+		tail(),
+		numPartitions(1), numSpectra(0), inputIdx(0), pos(0), numAccumulated(0)
+	{}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::reset() noexcept
+	{
+		std::fill(inputRe.begin(), inputRe.end(), static_cast<Float>(0));
+		std::fill(inputIm.begin(), inputIm.end(), static_cast<Float>(0));
+		history.fill(0);
+		tail.fill(0);
+		accRe.fill(0);
+		accIm.fill(0);
+		inputIdx = 0;
+		pos = 0;
+		numAccumulated = 0;
+	}
+
+	template<typename Float>
+	bool AllpassSlopeConvolution<Float>::updateParameters(double freqHz, double q, double sampleRate,
+		int numFilters, double thresholdDb, int maxLength)
+	{
+		maxLength = std::min(maxLength, MaxLength);
+		if (maxLength <= 0)
+			return false;
+
+		// the first stages decay long before the end of the rendering
+		juce::ScopedNoDenormals noDenormals;
+
+		cascade.updateParameters(freqHz, q, sampleRate, numFilters);
+		cascade.reset();
+		if (static_cast<int>(impulseResponse.size()) < maxLength)
+			impulseResponse.resize(maxLength);
+		auto ir = impulseResponse.data();
+		std::fill(ir, ir + maxLength, 0.);
+		ir[0] = 1.;
+		cascade.process(ir, maxLength, AllpassSlopeKernel::Wavefront, getNativeIsa());
+
+		// an allpass has unit energy, so whatever isn't rendered yet is the tail
+		const auto threshold = std::pow(10., thresholdDb * .1);
+		auto energy = 0.;
+		auto length = 0;
+		while (length < maxLength && 1. - energy > threshold)
+		{
+			energy += ir[length] * ir[length];
+			++length;
+		}
+		if (1. - energy > threshold)
+			return false;
+
+		setImpulseResponse(ir, length);
+		return true;
+	}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::setImpulseResponse(const double* ir, int length)
+	{
+		const auto& kernels = getKernels<Float>(getNativeIsa());
+		length = std::min(length, MaxLength);
+		numPartitions = std::max(1, (length + PartitionSize - 1) / PartitionSize);
+		const auto numBins = static_cast<size_t>(numPartitions * NumBins);
+		if (spectraRe.size() < numBins)
+		{
+			spectraRe.resize(numBins);
+			spectraIm.resize(numBins);
+		}
+		// the history only ever grows, so warm starts can reach back as far as possible
+		if (numSpectra < numPartitions)
+		{
+			numSpectra = numPartitions;
+			inputRe.assign(numBins, 0);
+			inputIm.assign(numBins, 0);
+			inputIdx = 0;
+		}
+		const auto getTap = [ir, length](int i)
+		{
+			return i < length ? static_cast<Float>(ir[i]) : static_cast<Float>(0);
+		};
+
+		for (auto i = 0; i < PartitionSize; ++i)
+			head[i] = getTap(i);
+
+		for (auto p = 1; p < numPartitions; ++p)
+		{
+			for (auto i = 0; i < PartitionSize; ++i)
+			{
+				window[i] = getTap(p * PartitionSize + i);
+				window[PartitionSize + i] = 0;
+			}
+			fft.forward(window.data(), &spectraRe[p * NumBins], &spectraIm[p * NumBins], kernels);
+		}
+	}
+
+	template<typename Float>
+	bool AllpassSlopeConvolution<Float>::warmStart(const AllpassSlopeConvolution& other) noexcept
+	{
+		// a head-only impulse response doesn't keep the spectra of its input,
+		// and a shorter one might not have kept as many as this one needs
+		if (numPartitions > 1 && (other.numPartitions == 1 || other.numSpectra < numPartitions - 1))
+			return false;
+
+		// only the spectra this impulse response reaches back to, later ones are computed as usual
+		if (numPartitions > 1)
+			inputIdx = other.inputIdx % numSpectra;
+		for (auto p = 0; p < numPartitions - 1; ++p)
+		{
+			const auto from = ((other.inputIdx - p + other.numSpectra) % other.numSpectra) * NumBins;
+			const auto to = ((inputIdx - p + numSpectra) % numSpectra) * NumBins;
+			std::copy(other.inputRe.begin() + from, other.inputRe.begin() + from + NumBins, inputRe.begin() + to);
+			std::copy(other.inputIm.begin() + from, other.inputIm.begin() + from + NumBins, inputIm.begin() + to);
+		}
+		history = other.history;
+		pos = other.pos;
+		// the rest of the current partition was computed with other's impulse response
+		tail.fill(0);
+		accRe.fill(0);
+		accIm.fill(0);
+		numAccumulated = 0;
+		if (numPartitions == 1)
+			return true;
+		const auto& kernels = getKernels<Float>(getNativeIsa());
+		for (auto p = 1; p < numPartitions; ++p)
+		{
+			const auto idx = (inputIdx - (p - 1) + numSpectra) % numSpectra;
+			kernels.complexMultiplyAdd(accRe.data(), accIm.data(), &inputRe[idx * NumBins], &inputIm[idx * NumBins],
+				&spectraRe[p * NumBins], &spectraIm[p * NumBins], NumBins);
+		}
+		updateTail(kernels);
+		return true;
+	}
+
+	template<typename Float>
+	int AllpassSlopeConvolution<Float>::getLength() const noexcept
+	{
+		return numPartitions * PartitionSize;
+	}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::accumulate(int numTerms, const Kernels<Float>& kernels) noexcept
+	{
+		// partition p + 2 goes with the spectrum p partitions before the latest one
+		for (; numAccumulated < numTerms; ++numAccumulated)
+		{
+			const auto idx = (inputIdx - numAccumulated + numSpectra) % numSpectra;
+			const auto p = numAccumulated + 2;
+			kernels.complexMultiplyAdd(accRe.data(), accIm.data(), &inputRe[idx * NumBins], &inputIm[idx * NumBins],
+				&spectraRe[p * NumBins], &spectraIm[p * NumBins], NumBins);
+		}
+	}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::updateTail(const Kernels<Float>& kernels) noexcept
+	{
+		// overlap-save: only the second half is free of circular wrap-around
+		fft.inverse(accRe.data(), accIm.data(), window.data(), kernels);
+		std::copy(window.begin() + PartitionSize, window.end(), tail.begin());
+		accRe.fill(0);
+		accIm.fill(0);
+		numAccumulated = 0;
+	}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::processPartition(const Kernels<Float>& kernels) noexcept
+	{
+		// a head-only impulse response doesn't need the frequency domain at all
+		if (numPartitions == 1)
+		{
+			std::copy(history.begin() + PartitionSize, history.end(), history.begin());
+			return;
+		}
+
+		// whatever wasn't accumulated during the partition yet
+		accumulate(numPartitions - 2, kernels);
+
+		// spectrum of the last 2 input partitions, only the next partition needs it right away
+		inputIdx = (inputIdx + 1) % numSpectra;
+		const auto inRe = &inputRe[inputIdx * NumBins];
+		const auto inIm = &inputIm[inputIdx * NumBins];
+		fft.forward(history.data(), inRe, inIm, kernels);
+		kernels.complexMultiplyAdd(accRe.data(), accIm.data(), inRe, inIm,
+			&spectraRe[NumBins], &spectraIm[NumBins], NumBins);
+
+		updateTail(kernels);
+
+		std::copy(history.begin() + PartitionSize, history.end(), history.begin());
+	}
+
+	template<typename Float>
+	void AllpassSlopeConvolution<Float>::process(Float* smpls, int numSamples, Isa isa) noexcept
+	{
+		using SIMD = juce::FloatVectorOperations;
+		const auto& kernels = getKernels<Float>(isa);
+
+		while (numSamples > 0)
+		{
+			const auto n = std::min(PartitionSize - pos, numSamples);
+			const auto input = &history[PartitionSize + pos];
+			SIMD::copy(input, smpls, n);
+
+			SIMD::copy(smpls, &tail[pos], n);
+			kernels.fir(smpls, input, head.data(), PartitionSize, n);
+
+			pos += n;
+			smpls += n;
+			numSamples -= n;
+			if (pos == PartitionSize)
+			{
+				processPartition(kernels);
+				pos = 0;
+			}
+		}
+
+		// as many of the products as the partition is through, so small blocks share the work evenly
+		if (numPartitions > 2)
+			accumulate((numPartitions - 2) * pos / PartitionSize, kernels);
+	}
+
+	template struct AllpassSlopeConvolution<float>;
+	template struct AllpassSlopeConvolution<double>;
+}
\ No newline at end of file
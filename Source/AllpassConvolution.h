@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include "Allpass.h"
+
+namespace dsp
+{
+	/*
+	real fft of Size samples through a complex fft of Size / 2,
+	spectra are kept as split re / im arrays of NumBins bins
+	*/
+	template<typename Float>
+	struct RealFFT
+	{
+		static constexpr int Size = 256;
+		static constexpr int NumBins = Size / 2 + 1;
+
+		RealFFT();
+
+		/* samples (Size), re, im, kernels */
+		void forward(const Float*, Float*, Float*, const Kernels<Float>&) noexcept;
+
+		/* re, im, samples (Size), kernels */
+		void inverse(const Float*, const Float*, Float*, const Kernels<Float>&) noexcept;
+
+	private:
+		static constexpr int Half = Size / 2;
+		// the twiddles of all passes back to back, 1 + 2 + 4 + .. of them
+		std::array<Float, Half> wRe, wIm, wImInverse;
+		std::array<Float, Half> tRe, tIm, re, im;
+		std::array<int, Half> bitReversed;
+
+		/* kernels, inverse
+		complex fft of re and im, which have to be in bit-reversed order */
+		void transform(const Kernels<Float>&, bool) noexcept;
+	};
+
+	/*
+	an AllpassSlope replaced by its impulse response, truncated where the energy left in the tail
+	falls below a threshold. uniformly partitioned convolution with a zero latency head:
+	the first partition runs as a direct fir, the others in the frequency domain, one partition behind.
+	all but the next partition only need input spectra that are already there,
+	so their products are spread over the partition instead of piling up on its boundary.
+	the spectra are only allocated once an impulse response needs them (on the thread that renders it),
+	so channels that never convolve don't carry them.
+	it's only used while it's cheaper than running the cascade itself
+	*/
+	template<typename Float>
+	struct AllpassSlopeConvolution
+	{
+		static constexpr int PartitionSize = RealFFT<Float>::Size / 2;
+		static constexpr int MaxPartitions = 64;
+		static constexpr int MaxLength = PartitionSize * MaxPartitions;
+
+		AllpassSlopeConvolution();
+
+		void reset() noexcept;
+
+		/* freqHz, q, sampleRate, numFilters, thresholdDb, maxLength
+		renders the impulse response. returns false if it's longer than maxLength,
+		which should be the longest one that's still cheaper than the cascade.
+		reset() before processing, the input history is lost if it had to grow */
+		bool updateParameters(double, double, double, int, double, int);
+
+		/* impulseResponse, length (up to MaxLength) */
+		void setImpulseResponse(const double*, int);
+
+		/* other
+		takes over other's input history, so the output continues as if this impulse response
+		had been convolved all along. returns false if other didn't keep enough of it */
+		bool warmStart(const AllpassSlopeConvolution&) noexcept;
+
+		/* the impulse response's length in samples, rounded up to whole partitions */
+		int getLength() const noexcept;
+
+		/* smpls, numSamples, isa */
+		void process(Float*, int, Isa) noexcept;
+
+	private:
+		static constexpr int NumBins = RealFFT<Float>::NumBins;
+
+		RealFFT<Float> fft;
+		AllpassSlope<double> cascade;
+		std::vector<double> impulseResponse;
+		std::array<Float, PartitionSize> head;
+		std::vector<Float> spectraRe, spectraIm, inputRe, inputIm;
+		std::array<Float, NumBins> accRe, accIm;
+		std::array<Float, 2 * PartitionSize> history, window;
+		std::array<Float, PartitionSize> tail;
+		// input spectra the history holds, numAccumulated of the partitions after the next one
+		// are in accRe and accIm already
+		int numPartitions, numSpectra, inputIdx, pos, numAccumulated;
+
+		/* numTerms, kernels
+		adds the products of the partitions after the next one to the accumulator, up to numTerms of them */
+		void accumulate(int, const Kernels<Float>&) noexcept;
+
+		/* kernels
+		the output of the partition after the latest input spectrum, minus the head,
+		from the products in the accumulator, which starts over */
+		void updateTail(const Kernels<Float>&) noexcept;
+
+		/* kernels */
+		void processPartition(const Kernels<Float>&) noexcept;
+	};
+}
\ No newline at end of file
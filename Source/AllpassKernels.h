@@ -0,0 +1,687 @@
+#pragma once
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include "Allpass.h"
+#include "Dispatch.h"
+#if ALLHAAS_X86 && ALLHAAS_SSE2
+#include <immintrin.h>
+#endif
+
+/*
+the vector kernels, compiled once per Isa:
+AllpassKernelsSSE2.cpp, AllpassKernelsAVX2.cpp and AllpassKernelsAVX512.cpp each define
+their ALLHAAS_ISA_ macro and include this file once. the target region lets gcc and clang
+emit the instruction set without per-file compiler flags, msvc emits intrinsics as they are
+*/
+#if defined(ALLHAAS_ISA_AVX512)
+#define ALLHAAS_ISA_NAMESPACE isa_avx512
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+#elif defined(ALLHAAS_ISA_AVX2)
+#define ALLHAAS_ISA_NAMESPACE isa_avx2
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2,fma"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+#else
+#define ALLHAAS_ISA_NAMESPACE isa_sse2
+#endif
+
+#include "Vec.h"
+
+namespace dsp
+{
+	namespace ALLHAAS_ISA_NAMESPACE
+	{
+		namespace
+		{
+			template<typename Func, int... Is>
+			inline void unroll(Func&& func, std::integer_sequence<int, Is...>) noexcept
+			{
+				(func(std::integral_constant<int, Is>()), ...);
+			}
+
+			/* func(std::integral_constant<int, i>) for i in [0, N) */
+			template<int N, typename Func>
+			inline void unroll(Func&& func) noexcept
+			{
+				unroll(func, std::make_integer_sequence<int, N>());
+			}
+
+			template<typename Float>
+			inline Float sum(Vec<Float> v) noexcept
+			{
+				alignas(64) Float x[Vec<Float>::Width];
+				v.store(x);
+				Float y = 0;
+				for (auto i = 0; i < Vec<Float>::Width; ++i)
+					y += x[i];
+				return y;
+			}
+
+			/* smpls, numSamples, a0, a1, z1, z2 */
+			template<typename Float>
+			inline void processStage(Float* smpls, int numSamples,
+				Float a0, Float a1, Float& z1, Float& z2) noexcept
+			{
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					const auto x = smpls[s];
+					const auto y = a0 * x + z1;
+					z1 = a1 * (x - y) + z2;
+					z2 = x - a0 * y;
+					smpls[s] = y;
+				}
+			}
+
+			///
+
+			static constexpr int WavefrontNumRegs = 2;
+
+			/* xIn, masks, a0, a1, y, z1, z2 */
+			template<bool Masked, typename Float>
+			inline void wavefrontStep(Float xIn, const Vec<Float>* m, Vec<Float> a0, Vec<Float> a1,
+				Vec<Float>* y, Vec<Float>* z1, Vec<Float>* z2) noexcept
+			{
+				using V = Vec<Float>;
+				static constexpr int NumRegs = WavefrontNumRegs;
+
+				V x[NumRegs];
+				x[0] = V::shiftIn(V::broadcast(xIn), y[0]);
+				for (auto r = 1; r < NumRegs; ++r)
+					x[r] = V::shiftIn(y[r - 1], y[r]);
+
+				for (auto r = 0; r < NumRegs; ++r)
+				{
+					const auto ny = a0 * x[r] + z1[r];
+					const auto nz1 = a1 * (x[r] - ny) + z2[r];
+					const auto nz2 = x[r] - a0 * ny;
+					if constexpr (Masked)
+					{
+						y[r] = V::select(m[r], ny, y[r]);
+						z1[r] = V::select(m[r], nz1, z1[r]);
+						z2[r] = V::select(m[r], nz2, z2[r]);
+					}
+					else
+					{
+						y[r] = ny;
+						z1[r] = nz1;
+						z2[r] = nz2;
+					}
+				}
+			}
+
+			template<typename Float>
+			int wavefront(Float* smpls, int numSamples, Float a0, Float a1,
+				Float* z1, Float* z2, int numFilters) noexcept
+			{
+				using V = Vec<Float>;
+				static constexpr int NumRegs = WavefrontNumRegs;
+				static constexpr int GroupSize = NumRegs * V::Width;
+
+				const auto numGroups = V::Width == 1 || numSamples < GroupSize ? 0 : numFilters / GroupSize;
+				const auto a0V = V::broadcast(a0);
+				const auto a1V = V::broadcast(a1);
+
+				alignas(64) Float laneIdx[GroupSize];
+				for (auto j = 0; j < GroupSize; ++j)
+					laneIdx[j] = static_cast<Float>(j);
+				V idx[NumRegs];
+				for (auto r = 0; r < NumRegs; ++r)
+					idx[r] = V::load(&laneIdx[r * V::Width]);
+
+				for (auto g = 0; g < numGroups; ++g)
+				{
+					const auto z1s = &z1[g * GroupSize];
+					const auto z2s = &z2[g * GroupSize];
+
+					V y[NumRegs], z1V[NumRegs], z2V[NumRegs], m[NumRegs];
+					for (auto r = 0; r < NumRegs; ++r)
+					{
+						y[r] = V::zero();
+						z1V[r] = V::load(&z1s[r * V::Width]);
+						z2V[r] = V::load(&z2s[r * V::Width]);
+					}
+
+					// fill: lane j starts at step j
+					auto t = 0;
+					for (; t < GroupSize - 1; ++t)
+					{
+						const auto tV = V::broadcast(static_cast<Float>(t + 1));
+						for (auto r = 0; r < NumRegs; ++r)
+							m[r] = V::lessThan(idx[r], tV);
+						wavefrontStep<true>(smpls[t], m, a0V, a1V, y, z1V, z2V);
+					}
+
+					for (; t < numSamples; ++t)
+					{
+						wavefrontStep<false>(smpls[t], m, a0V, a1V, y, z1V, z2V);
+						smpls[t - GroupSize + 1] = V::last(y[NumRegs - 1]);
+					}
+
+					// drain: lane j stops after sample numSamples - 1
+					for (; t < numSamples + GroupSize - 1; ++t)
+					{
+						const auto tV = V::broadcast(static_cast<Float>(t - numSamples));
+						for (auto r = 0; r < NumRegs; ++r)
+							m[r] = V::lessThan(tV, idx[r]);
+						wavefrontStep<true>(Float(0), m, a0V, a1V, y, z1V, z2V);
+						smpls[t - GroupSize + 1] = V::last(y[NumRegs - 1]);
+					}
+
+					for (auto r = 0; r < NumRegs; ++r)
+					{
+						z1V[r].store(&z1s[r * V::Width]);
+						z2V[r].store(&z2s[r * V::Width]);
+					}
+				}
+
+				return numGroups * GroupSize;
+			}
+
+			///
+
+			template<typename Float>
+			void stateSpace(Float* smpls, int numSamples, const AllpassBlockStateSpace<Float>& ss,
+				Float a0, Float a1, Float* z1, Float* z2, int numFilters) noexcept
+			{
+				using V = Vec<Float>;
+				static constexpr int K = AllpassBlockStateSpace<Float>::Order;
+				static constexpr int W = V::Width;
+				static constexpr int R = K / W;
+
+				const auto h = &ss.hPad[K];
+				const auto numChunked = numSamples - numSamples % K;
+
+				for (auto i = 0; i < numFilters; ++i)
+				{
+					auto _z1 = z1[i];
+					auto _z2 = z2[i];
+
+					for (auto s0 = 0; s0 < numChunked; s0 += K)
+					{
+						auto x = &smpls[s0];
+
+						V y[R];
+						const auto z1V = V::broadcast(_z1);
+						const auto z2V = V::broadcast(_z2);
+						for (auto r = 0; r < R; ++r)
+							y[r] = V::load(&ss.o1[r * W]) * z1V + V::load(&ss.o2[r * W]) * z2V;
+
+						// y[n] += h[n - m] * x[m], the zero padding takes care of n < m within a vector.
+						// unrolled at compile time so y stays in registers and the triangle's empty half is skipped
+						unroll<K>([&](auto m)
+						{
+							const auto xm = V::broadcast(x[m]);
+							unroll<R>([&](auto r)
+							{
+								if constexpr (r >= m / W)
+									y[r] = y[r] + xm * V::load(&h[r * W - m]);
+							});
+						});
+
+						auto acc1 = V::zero();
+						auto acc2 = V::zero();
+						for (auto r = 0; r < R; ++r)
+						{
+							const auto xV = V::load(&x[r * W]);
+							acc1 = acc1 + V::load(&ss.g1[r * W]) * xV;
+							acc2 = acc2 + V::load(&ss.g2[r * W]) * xV;
+						}
+						const auto nz1 = ss.aK11 * _z1 + ss.aK12 * _z2 + sum(acc1);
+						_z2 = ss.aK21 * _z1 + ss.aK22 * _z2 + sum(acc2);
+						_z1 = nz1;
+
+						for (auto r = 0; r < R; ++r)
+							y[r].store(&x[r * W]);
+					}
+
+					processStage(&smpls[numChunked], numSamples - numChunked, a0, a1, _z1, _z2);
+					z1[i] = _z1;
+					z2[i] = _z2;
+				}
+			}
+
+			///
+
+			/* interleaved samples, numSamples, a0, a1, numStages, stage, z1, z2 */
+			template<int NumRegs, bool Masked, typename Float>
+			void lanesStage(Float* inter, int numSamples,
+				const Float* a0s, const Float* a1s, const Float* numStages,
+				int stage, Float* z1s, Float* z2s) noexcept
+			{
+				using V = Vec<Float>;
+				static constexpr int W = V::Width;
+				static constexpr int Stride = NumRegs * W;
+
+				V a0[NumRegs], a1[NumRegs], m[NumRegs], z1[NumRegs], z2[NumRegs];
+				const auto k = V::broadcast(static_cast<Float>(stage));
+				for (auto r = 0; r < NumRegs; ++r)
+				{
+					a0[r] = V::load(&a0s[r * W]);
+					a1[r] = V::load(&a1s[r * W]);
+					m[r] = V::lessThan(k, V::load(&numStages[r * W]));
+					z1[r] = V::load(&z1s[r * W]);
+					z2[r] = V::load(&z2s[r * W]);
+				}
+
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					auto smpls = &inter[s * Stride];
+					for (auto r = 0; r < NumRegs; ++r)
+					{
+						const auto x = V::load(&smpls[r * W]);
+						auto y = a0[r] * x + z1[r];
+						const auto nz1 = a1[r] * (x - y) + z2[r];
+						const auto nz2 = x - a0[r] * y;
+						if constexpr (Masked)
+						{
+							y = V::select(m[r], y, x);
+							z1[r] = V::select(m[r], nz1, z1[r]);
+							z2[r] = V::select(m[r], nz2, z2[r]);
+						}
+						else
+						{
+							z1[r] = nz1;
+							z2[r] = nz2;
+						}
+						y.store(&smpls[r * W]);
+					}
+				}
+
+				for (auto r = 0; r < NumRegs; ++r)
+				{
+					z1[r].store(&z1s[r * W]);
+					z2[r].store(&z2s[r * W]);
+				}
+			}
+
+			template<int NumRegs, typename Float>
+			inline void lanesStage(Float* inter, int numSamples,
+				const Float* a0s, const Float* a1s, const Float* numStages,
+				int stage, bool masked, Float* z1s, Float* z2s) noexcept
+			{
+				if (masked)
+					lanesStage<NumRegs, true>(inter, numSamples, a0s, a1s, numStages, stage, z1s, z2s);
+				else
+					lanesStage<NumRegs, false>(inter, numSamples, a0s, a1s, numStages, stage, z1s, z2s);
+			}
+
+			template<typename Float>
+			void lanesStage(Float* inter, int numRegs, int numSamples,
+				const Float* a0s, const Float* a1s, const Float* numStages,
+				int stage, bool masked, Float* z1s, Float* z2s) noexcept
+			{
+				switch (numRegs)
+				{
+				case 1: return lanesStage<1>(inter, numSamples, a0s, a1s, numStages, stage, masked, z1s, z2s);
+				case 2: return lanesStage<2>(inter, numSamples, a0s, a1s, numStages, stage, masked, z1s, z2s);
+				case 3: return lanesStage<3>(inter, numSamples, a0s, a1s, numStages, stage, masked, z1s, z2s);
+				default: return lanesStage<4>(inter, numSamples, a0s, a1s, numStages, stage, masked, z1s, z2s);
+				}
+			}
+
+			///
+
+			template<typename Float>
+			void multiply(Float* dest, const Float* src, const Float* gain, int numSamples) noexcept
+			{
+				using V = Vec<Float>;
+				auto s = 0;
+				for (; s <= numSamples - V::Width; s += V::Width)
+					(V::load(&src[s]) * V::load(&gain[s])).store(&dest[s]);
+				for (; s < numSamples; ++s)
+					dest[s] = src[s] * gain[s];
+			}
+
+			template<typename Float>
+			void addWithMultiply(Float* dest, const Float* src, const Float* gain, int numSamples) noexcept
+			{
+				using V = Vec<Float>;
+				auto s = 0;
+				for (; s <= numSamples - V::Width; s += V::Width)
+					(V::load(&dest[s]) + V::load(&src[s]) * V::load(&gain[s])).store(&dest[s]);
+				for (; s < numSamples; ++s)
+					dest[s] += src[s] * gain[s];
+			}
+
+			template<typename Float>
+			void encodeMidSide(Float* left, Float* right, int numSamples) noexcept
+			{
+				using V = Vec<Float>;
+				const auto half = V::broadcast(static_cast<Float>(.5));
+				auto s = 0;
+				for (; s <= numSamples - V::Width; s += V::Width)
+				{
+					const auto l = V::load(&left[s]), r = V::load(&right[s]);
+					((l + r) * half).store(&left[s]);
+					((l - r) * half).store(&right[s]);
+				}
+				for (; s < numSamples; ++s)
+				{
+					const auto l = left[s], r = right[s];
+					left[s] = (l + r) * static_cast<Float>(.5);
+					right[s] = (l - r) * static_cast<Float>(.5);
+				}
+			}
+
+			template<typename Float, bool MidSide, bool Mono>
+			Float decodeSample(Float& l, Float& r) noexcept
+			{
+				// the mono fold of a decoded mid / side pair is just the mid
+				if (MidSide && Mono)
+					r = l;
+				else if (MidSide)
+				{
+					const auto m = l;
+					l = m + r;
+					r = m - r;
+				}
+				else if (Mono)
+					l = r = (l + r) * static_cast<Float>(.5);
+				return l * l < r * r ? r * r : l * l;
+			}
+
+			template<typename Float, bool MidSide, bool Mono>
+			int decodeOutputWith(Float* left, Float* right, int numSamples) noexcept
+			{
+				using V = Vec<Float>;
+				const auto half = V::broadcast(static_cast<Float>(.5));
+				const auto step = V::broadcast(static_cast<Float>(2 * V::Width));
+				// decodes the vector at i and keeps the loudest square per lane and the first sample it was reached at
+				const auto decode = [&](int i, V idx, V& peak, V& peakIdx)
+				{
+					auto l = V::load(&left[i]), r = V::load(&right[i]);
+					if (MidSide && Mono)
+						r = l;
+					else if (MidSide)
+					{
+						const auto m = l;
+						l = m + r;
+						r = m - r;
+					}
+					else if (Mono)
+						l = r = (l + r) * half;
+					l.store(&left[i]);
+					r.store(&right[i]);
+
+					const auto ll = l * l, rr = r * r;
+					const auto mag = V::select(V::lessThan(ll, rr), rr, ll);
+					const auto louder = V::lessThan(peak, mag);
+					peak = V::select(louder, mag, peak);
+					peakIdx = V::select(louder, idx, peakIdx);
+				};
+
+				// two interleaved sets of lanes, so consecutive compares don't wait on each other
+				alignas(64) Float laneIdx[2 * V::Width];
+				for (auto l = 0; l < 2 * V::Width; ++l)
+					laneIdx[l] = static_cast<Float>(l);
+				auto idx0 = V::load(laneIdx), idx1 = V::load(&laneIdx[V::Width]);
+				auto peak0 = V::broadcast(static_cast<Float>(-1)), peak1 = peak0;
+				auto peakIdx0 = V::zero(), peakIdx1 = peakIdx0;
+
+				auto s = 0;
+				for (; s <= numSamples - 2 * V::Width; s += 2 * V::Width)
+				{
+					decode(s, idx0, peak0, peakIdx0);
+					decode(s + V::Width, idx1, peak1, peakIdx1);
+					idx0 = idx0 + step;
+					idx1 = idx1 + step;
+				}
+
+				alignas(64) Float lanePeak[2 * V::Width];
+				peak0.store(lanePeak);
+				peak1.store(&lanePeak[V::Width]);
+				peakIdx0.store(laneIdx);
+				peakIdx1.store(&laneIdx[V::Width]);
+				auto maxMag = static_cast<Float>(-1);
+				auto maxIdx = 0;
+				for (auto l = 0; l < 2 * V::Width; ++l)
+				{
+					const auto i = static_cast<int>(laneIdx[l]);
+					if (maxMag < lanePeak[l] || (maxMag == lanePeak[l] && i < maxIdx))
+					{
+						maxMag = lanePeak[l];
+						maxIdx = i;
+					}
+				}
+
+				for (; s < numSamples; ++s)
+				{
+					const auto mag = decodeSample<Float, MidSide, Mono>(left[s], right[s]);
+					if (maxMag < mag)
+					{
+						maxMag = mag;
+						maxIdx = s;
+					}
+				}
+				return maxIdx;
+			}
+
+			template<typename Float>
+			int decodeOutput(Float* left, Float* right, int numSamples, bool midSide, bool mono) noexcept
+			{
+				if (midSide)
+					return mono ? decodeOutputWith<Float, true, true>(left, right, numSamples)
+						: decodeOutputWith<Float, true, false>(left, right, numSamples);
+				return mono ? decodeOutputWith<Float, false, true>(left, right, numSamples)
+					: decodeOutputWith<Float, false, false>(left, right, numSamples);
+			}
+
+			template<typename Float>
+			Float maxSquare(const Float* smpls, int numSamples) noexcept
+			{
+				using V = Vec<Float>;
+				auto peak = V::zero();
+				auto s = 0;
+				for (; s <= numSamples - V::Width; s += V::Width)
+				{
+					const auto x = V::load(&smpls[s]);
+					const auto xx = x * x;
+					peak = V::select(V::lessThan(peak, xx), xx, peak);
+				}
+
+				alignas(64) Float lanePeak[V::Width];
+				peak.store(lanePeak);
+				auto max = static_cast<Float>(0);
+				for (auto l = 0; l < V::Width; ++l)
+					max = std::max(max, lanePeak[l]);
+				for (; s < numSamples; ++s)
+					max = std::max(max, smpls[s] * smpls[s]);
+				return max;
+			}
+
+			/* sin(pi * t) / t as a polynomial in t * t, for |t| <= .5 (chebyshev fits, scaled so sin(pi / 2) is 1).
+			the max error is 1.3e-8 for float and 1.5e-15 for double */
+			static constexpr double SinPiFloat[] = { 3.1415926191868584, -5.167710042305049,
+				2.5500773695711163, -.5982904073004736, .07765591175141988 };
+			static constexpr double SinPiDouble[] = { 3.141592653589791, -5.167712780049541,
+				2.550164039857472, -.5992645288760061, .08214588059490784,
+				-.007370379666099328, .0004660417325794699, -2.1204352378845225e-05 };
+
+			template<typename Float>
+			inline Vec<Float> sinPi(Vec<Float> t) noexcept
+			{
+				using V = Vec<Float>;
+				const auto t2 = t * t;
+				const auto evaluate = [&](const auto& coefs)
+				{
+					constexpr auto NumCoefs = static_cast<int>(sizeof(coefs) / sizeof(coefs[0]));
+					auto p = V::broadcast(static_cast<Float>(coefs[NumCoefs - 1]));
+					for (auto i = NumCoefs - 2; i >= 0; --i)
+						p = p * t2 + V::broadcast(static_cast<Float>(coefs[i]));
+					return t * p;
+				};
+				if constexpr (std::is_same<Float, float>::value)
+					return evaluate(SinPiFloat);
+				else
+					return evaluate(SinPiDouble);
+			}
+
+			template<typename Float>
+			void fadeCurve(Float* gains, int numSamples, bool constantPower) noexcept
+			{
+				using V = Vec<Float>;
+				// constant gain: .5 - .5 * cos(pi * g) = .5 + .5 * sin(pi * (g - .5)), constant power: sin(pi * g / 2)
+				const auto inScale = V::broadcast(static_cast<Float>(constantPower ? .5 : 1.));
+				const auto inOffset = V::broadcast(static_cast<Float>(constantPower ? 0. : -.5));
+				const auto outScale = V::broadcast(static_cast<Float>(constantPower ? 1. : .5));
+				const auto outOffset = V::broadcast(static_cast<Float>(constantPower ? 0. : .5));
+				const auto curve = [&](V g)
+				{
+					return sinPi<Float>(g * inScale + inOffset) * outScale + outOffset;
+				};
+
+				auto s = 0;
+				for (; s <= numSamples - V::Width; s += V::Width)
+					curve(V::load(&gains[s])).store(&gains[s]);
+				if (s == numSamples)
+					return;
+
+				// the rest goes through one padded vector
+				std::array<Float, V::Width> rest = {};
+				std::copy(&gains[s], &gains[numSamples], rest.begin());
+				curve(V::load(rest.data())).store(rest.data());
+				std::copy(rest.begin(), rest.begin() + (numSamples - s), &gains[s]);
+			}
+
+			/* dest, src, taps, numTaps, s: NumAcc vectors of fir output from sample s on */
+			template<int NumAcc, typename Float>
+			inline void firBlock(Float* dest, const Float* src, const Float* taps, int numTaps, int s) noexcept
+			{
+				using V = Vec<Float>;
+				V acc[NumAcc];
+				unroll<NumAcc>([&](auto a) { acc[a] = V::load(&dest[s + a * V::Width]); });
+				for (auto t = 0; t < numTaps; ++t)
+				{
+					const auto tap = V::broadcast(taps[t]);
+					unroll<NumAcc>([&](auto a) { acc[a] = acc[a] + tap * V::load(&src[s + a * V::Width - t]); });
+				}
+				unroll<NumAcc>([&](auto a) { acc[a].store(&dest[s + a * V::Width]); });
+			}
+
+			template<typename Float>
+			void fir(Float* dest, const Float* src, const Float* taps, int numTaps, int numSamples) noexcept
+			{
+				// enough independent accumulators to hide the latency of the adds
+				static constexpr int NumAcc = 8;
+				using V = Vec<Float>;
+				auto s = 0;
+				for (; s <= numSamples - NumAcc * V::Width; s += NumAcc * V::Width)
+					firBlock<NumAcc>(dest, src, taps, numTaps, s);
+				for (; s <= numSamples - V::Width; s += V::Width)
+					firBlock<1>(dest, src, taps, numTaps, s);
+				for (; s < numSamples; ++s)
+				{
+					auto acc = dest[s];
+					for (auto t = 0; t < numTaps; ++t)
+						acc += taps[t] * src[s - t];
+					dest[s] = acc;
+				}
+			}
+
+			template<typename Float>
+			void butterflies(Float* re, Float* im, const Float* wRe, const Float* wIm, int size, int halfLen) noexcept
+			{
+				using V = Vec<Float>;
+				// passes narrower than a vector loop over the groups instead, one twiddle at a time
+				if (halfLen < V::Width)
+				{
+					for (auto k = 0; k < halfLen; ++k)
+					{
+						const auto w0 = wRe[k], w1 = wIm[k];
+						for (auto a = k; a < size; a += 2 * halfLen)
+						{
+							const auto b = a + halfLen;
+							const auto xRe = re[b] * w0 - im[b] * w1;
+							const auto xIm = re[b] * w1 + im[b] * w0;
+							re[b] = re[a] - xRe;
+							im[b] = im[a] - xIm;
+							re[a] += xRe;
+							im[a] += xIm;
+						}
+					}
+					return;
+				}
+
+				for (auto i = 0; i < size; i += 2 * halfLen)
+				{
+					auto k = 0;
+					for (; k <= halfLen - V::Width; k += V::Width)
+					{
+						const auto a = i + k, b = a + halfLen;
+						const auto w0 = V::load(&wRe[k]), w1 = V::load(&wIm[k]);
+						const auto bRe = V::load(&re[b]), bIm = V::load(&im[b]);
+						const auto aRe = V::load(&re[a]), aIm = V::load(&im[a]);
+						const auto xRe = bRe * w0 - bIm * w1;
+						const auto xIm = bRe * w1 + bIm * w0;
+						(aRe - xRe).store(&re[b]);
+						(aIm - xIm).store(&im[b]);
+						(aRe + xRe).store(&re[a]);
+						(aIm + xIm).store(&im[a]);
+					}
+				}
+			}
+
+			template<typename Float>
+			void complexMultiplyAdd(Float* accRe, Float* accIm, const Float* xRe, const Float* xIm,
+				const Float* hRe, const Float* hIm, int numBins) noexcept
+			{
+				using V = Vec<Float>;
+				auto k = 0;
+				for (; k <= numBins - V::Width; k += V::Width)
+				{
+					const auto xr = V::load(&xRe[k]), xi = V::load(&xIm[k]);
+					const auto hr = V::load(&hRe[k]), hi = V::load(&hIm[k]);
+					(V::load(&accRe[k]) + xr * hr - xi * hi).store(&accRe[k]);
+					(V::load(&accIm[k]) + xr * hi + xi * hr).store(&accIm[k]);
+				}
+				for (; k < numBins; ++k)
+				{
+					accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+					accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+				}
+			}
+		}
+
+		template<typename Float>
+		const Kernels<Float>& getKernels() noexcept
+		{
+			static constexpr Kernels<Float> kernels
+			{
+				Vec<Float>::Width,
+				&wavefront<Float>,
+				&stateSpace<Float>,
+				&lanesStage<Float>,
+				&multiply<Float>,
+				&addWithMultiply<Float>,
+				&fadeCurve<Float>,
+				&encodeMidSide<Float>,
+				&decodeOutput<Float>,
+				&maxSquare<Float>,
+				&fir<Float>,
+				&complexMultiplyAdd<Float>,
+				&butterflies<Float>
+			};
+			return kernels;
+		}
+
+		template const Kernels<float>& getKernels<float>() noexcept;
+		template const Kernels<double>& getKernels<double>() noexcept;
+	}
+}
+
+#if defined(ALLHAAS_ISA_AVX512) || defined(ALLHAAS_ISA_AVX2)
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif
\ No newline at end of file
@@ -0,0 +1,5 @@
+#include "Dispatch.h"
+#if ALLHAAS_X86 && ALLHAAS_SSE2
+#define ALLHAAS_ISA_AVX512 1
+#include "AllpassKernels.h"
+#endif
\ No newline at end of file
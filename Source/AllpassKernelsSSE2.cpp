@@ -0,0 +1 @@
+#include "AllpassKernels.h"
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "AllpassLanes.h"
+
+namespace dsp
+{
+	namespace
+	{
+		/* widest stride the lanes can be interleaved with, over all Isas */
+		template<typename Float>
+		static constexpr int MaxStride = std::max(AllpassSlopeLanes<Float>::NumLanes,
+			MaxVectorBytes / static_cast<int>(sizeof(Float)));
+	}
+
+	template<typename Float>
+	void AllpassSlopeLanes<Float>::processCascades(AllpassSlope<Float>* const* cascades, Float* inter,
+		int numLanes, int numSamples, const Kernels<Float>& kernels) noexcept
+	{
+		static constexpr int MaxStride = dsp::MaxStride<Float>;
+		alignas(64) Float a0[MaxStride], a1[MaxStride], numStages[MaxStride];
+		alignas(64) Float z1[MaxStride], z2[MaxStride];
+		const auto numRegs = (numLanes + kernels.vectorWidth - 1) / kernels.vectorWidth;
+
+		auto minStages = axiom::NumAllpassFilters;
+		auto maxStages = 0;
+		for (auto l = 0; l < MaxStride; ++l)
+		{
+			a0[l] = a1[l] = numStages[l] = z1[l] = z2[l] = 0;
+			if (l < numLanes)
+			{
+				const auto& cascade = *cascades[l];
+				a0[l] = cascade.a0;
+				a1[l] = cascade.a1;
+				numStages[l] = static_cast<Float>(cascade.numFilters);
+				minStages = std::min(minStages, cascade.numFilters);
+				maxStages = std::max(maxStages, cascade.numFilters);
+			}
+		}
+
+		for (auto k = 0; k < maxStages; ++k)
+		{
+			for (auto l = 0; l < numLanes; ++l)
+				if (k < cascades[l]->numFilters)
+				{
+					z1[l] = cascades[l]->z1[k];
+					z2[l] = cascades[l]->z2[k];
+				}
+
+			kernels.lanesStage(inter, numRegs, numSamples, a0, a1, numStages, k, k >= minStages, z1, z2);
+
+			for (auto l = 0; l < numLanes; ++l)
+				if (k < cascades[l]->numFilters)
+				{
+					cascades[l]->z1[k] = z1[l];
+					cascades[l]->z2[k] = z2[l];
+				}
+		}
+	}
+
+	template<typename Float>
+	AllpassSlopeLanes<Float>::AllpassSlopeLanes() :
+		inter(nullptr)
+	{}
+
+	template<typename Float>
+	int AllpassSlopeLanes<Float>::getScratchSize(int blockSize) noexcept
+	{
+		return MaxStride<Float> * blockSize;
+	}
+
+	template<typename Float>
+	void AllpassSlopeLanes<Float>::prepare(Float* scratch) noexcept
+	{
+		inter = scratch;
+	}
+
+	template<typename Float>
+	template<typename Sample>
+	void AllpassSlopeLanes<Float>::operator()(AllpassSlope<Float>* const* cascades,
+		const Sample* const* src, Sample* const* dest,
+		int numLanes, int numSamples, Isa isa) noexcept
+	{
+		const auto& kernels = getKernels<Float>(isa);
+		const auto w = kernels.vectorWidth;
+		const auto stride = (numLanes + w - 1) / w * w;
+
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			auto smpls = &inter[s * stride];
+			for (auto l = 0; l < numLanes; ++l)
+				smpls[l] = static_cast<Float>(src[l][s]);
+			for (auto l = numLanes; l < stride; ++l)
+				smpls[l] = 0;
+		}
+
+		processCascades(cascades, inter, numLanes, numSamples, kernels);
+
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			const auto smpls = &inter[s * stride];
+			for (auto l = 0; l < numLanes; ++l)
+				dest[l][s] = static_cast<Sample>(smpls[l]);
+		}
+	}
+
+	template struct AllpassSlopeLanes<float>;
+	template struct AllpassSlopeLanes<double>;
+	template void AllpassSlopeLanes<float>::operator()(AllpassSlope<float>* const*,
+		const float* const*, float* const*, int, int, Isa) noexcept;
+	template void AllpassSlopeLanes<double>::operator()(AllpassSlope<double>* const*,
+		const float* const*, float* const*, int, int, Isa) noexcept;
+	template void AllpassSlopeLanes<double>::operator()(AllpassSlope<double>* const*,
+		const double* const*, double* const*, int, int, Isa) noexcept;
+}
\ No newline at end of file
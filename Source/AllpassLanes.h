@@ -0,0 +1,38 @@
+#pragma once
+#include "Allpass.h"
+
+namespace dsp
+{
+	/*
+	runs independent AllpassSlope cascades side by side, one cascade per vector lane
+	(f.ex. L and R of both crossfade tracks).
+	the cascades keep their own coefficients and state,
+	lanes with fewer stages than the others are masked out of the trailing stages
+	*/
+	template<typename Float>
+	struct AllpassSlopeLanes
+	{
+		static constexpr int NumLanes = 4;
+
+		AllpassSlopeLanes();
+
+		/* blockSize
+		samples of scratch the interleaved lanes of blockSize samples take up */
+		static int getScratchSize(int) noexcept;
+
+		/* scratch
+		getScratchSize(blockSize) samples that outlive this, blocks can't be longer than blockSize */
+		void prepare(Float*) noexcept;
+
+		/* cascades, src, dest, numLanes, numSamples, isa
+		Sample is the host's sample type, the cascades run in Float */
+		template<typename Sample>
+		void operator()(AllpassSlope<Float>* const*, const Sample* const*, Sample* const*, int, int, Isa) noexcept;
+
+	private:
+		Float* inter;
+
+		/* cascades, interleaved samples, numLanes, numSamples, kernels */
+		static void processCascades(AllpassSlope<Float>* const*, Float*, int, int, const Kernels<Float>&) noexcept;
+	};
+}
\ No newline at end of file
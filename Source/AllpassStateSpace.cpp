@@ -0,0 +1,99 @@
+#include "Allpass.h"
+
+namespace dsp
+{
+	namespace
+	{
+		static constexpr int K = AllpassBlockStateSpace<double>::Order;
+		// latency of the stage's recurrence: add, sub, mul, add
+		static constexpr double DirectCyclesPerSample = 16.;
+	}
+
+	template<typename Float>
+	AllpassBlockStateSpace<Float>::AllpassBlockStateSpace() :
+		hPad(), o1(), o2(), g1(), g2(),
+		aK11(1), aK12(0), aK21(0), aK22(1)
+	{}
+
+	template<typename Float>
+	void AllpassBlockStateSpace<Float>::copyFrom(const AllpassBlockStateSpace& other) noexcept
+	{
+		*this = other;
+	}
+
+	// the matrices are derived in double and rounded once, so the float32 engine
+	// doesn't accumulate rounding error over the simulated block
+	template<typename Float>
+	void AllpassBlockStateSpace<Float>::updateParameters(double a0, double a1) noexcept
+	{
+		const auto tick = [a0, a1](double x, double& z1, double& z2)
+		{
+			const auto y = a0 * x + z1;
+			z1 = a1 * (x - y) + z2;
+			z2 = x - a0 * y;
+			return y;
+		};
+
+		// impulse response and the state it leaves behind after n + 1 samples
+		const auto toFloat = [](double x) { return static_cast<Float>(x); };
+
+		std::array<double, K + 1> s1, s2;
+		auto z1 = 0., z2 = 0.;
+		s1[0] = s2[0] = 0.;
+		for (auto n = 0; n < K; ++n)
+		{
+			hPad[n] = 0;
+			hPad[K + n] = toFloat(tick(n == 0 ? 1. : 0., z1, z2));
+			s1[n + 1] = z1;
+			s2[n + 1] = z2;
+		}
+		for (auto m = 0; m < K; ++m)
+		{
+			g1[m] = toFloat(s1[K - m]);
+			g2[m] = toFloat(s2[K - m]);
+		}
+
+		// zero-input responses of the unit states
+		z1 = 1.; z2 = 0.;
+		for (auto n = 0; n < K; ++n)
+			o1[n] = toFloat(tick(0., z1, z2));
+		aK11 = toFloat(z1);
+		aK21 = toFloat(z2);
+
+		z1 = 0.; z2 = 1.;
+		for (auto n = 0; n < K; ++n)
+			o2[n] = toFloat(tick(0., z1, z2));
+		aK12 = toFloat(z1);
+		aK22 = toFloat(z2);
+	}
+
+	template<typename Float>
+	double AllpassBlockStateSpace<Float>::getRelativeCost(int numSamples, int vectorWidth) noexcept
+	{
+		if (numSamples <= 0)
+			return 1.;
+		// one vector multiply-add per cycle: triangular toeplitz part, state readout and state update
+		const auto r = static_cast<double>(K / vectorWidth);
+		const auto chunkCycles = vectorWidth * r * (r + 1.) * .5 + 4. * r + 8.;
+		const auto numChunks = numSamples / K;
+		const auto remainder = numSamples - numChunks * K;
+		const auto cycles = numChunks * chunkCycles + remainder * DirectCyclesPerSample;
+		return cycles / (numSamples * DirectCyclesPerSample);
+	}
+
+	template struct AllpassBlockStateSpace<float>;
+	template struct AllpassBlockStateSpace<double>;
+
+	template<typename Float>
+	void AllpassSlope<Float>::processStateSpace(Float* smpls, int numSamples, Isa isa) noexcept
+	{
+		const auto& kernels = getKernels<Float>(isa);
+		if (AllpassBlockStateSpace<Float>::getRelativeCost(numSamples, kernels.vectorWidth) >= 1.)
+			return process(smpls, numSamples);
+
+		kernels.stateSpace(smpls, numSamples, stateSpace, a0, a1, z1.data(), z2.data(), numFilters);
+	}
+
+	template void AllpassSlope<float>::processStateSpace(float*, int, Isa) noexcept;
+	template void AllpassSlope<double>::processStateSpace(double*, int, Isa) noexcept;
+}
\ No newline at end of file
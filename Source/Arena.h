@@ -0,0 +1,67 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dsp
+{
+	/*
+	one block of memory per engine that all of its scratch buffers are carved from,
+	each of them starting on a Alignment byte boundary.
+	sized while preparing: add up getSize() of everything, reset() to that,
+	then allocate() the buffers. nothing is allocated after that
+	*/
+	struct Arena
+	{
+		static constexpr size_t Alignment = 64;
+
+		Arena() :
+			memory(),
+			base(nullptr),
+			size(0),
+			used(0)
+		{}
+
+		/* num
+		bytes num Ts take up in the arena, including the padding up to the next buffer */
+		template<typename T>
+		static size_t getSize(int num) noexcept
+		{
+			return (static_cast<size_t>(num) * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+		}
+
+		/* numBytes
+		drops all buffers handed out so far, only reallocates if numBytes don't fit yet */
+		void reset(size_t numBytes)
+		{
+			if (numBytes > size)
+			{
+				memory.assign(numBytes + Alignment, 0);
+				const auto address = reinterpret_cast<std::uintptr_t>(memory.data());
+				base = memory.data() + (Alignment - address % Alignment) % Alignment;
+				size = numBytes;
+			}
+			used = 0;
+		}
+
+		/* num
+		the next num Ts, zeroed */
+		template<typename T>
+		T* allocate(int num) noexcept
+		{
+			const auto numBytes = getSize<T>(num);
+			jassert(used + numBytes <= size);
+			auto buffer = base + used;
+			std::fill(buffer, buffer + numBytes, static_cast<char>(0));
+			used += numBytes;
+			return reinterpret_cast<T*>(buffer);
+		}
+
+	private:
+		std::vector<char> memory;
+		char* base;
+		size_t size, used;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "ChannelPairs.h"
+
+namespace dsp
+{
+	namespace
+	{
+		using Set = juce::AudioChannelSet;
+
+		// left channel types and their right counterparts
+		constexpr std::array<std::array<Set::ChannelType, 2>, 10> Counterparts =
+		{{
+			{ Set::left, Set::right },
+			{ Set::leftCentre, Set::rightCentre },
+			{ Set::wideLeft, Set::wideRight },
+			{ Set::leftSurroundSide, Set::rightSurroundSide },
+			{ Set::leftSurround, Set::rightSurround },
+			{ Set::leftSurroundRear, Set::rightSurroundRear },
+			{ Set::bottomFrontLeft, Set::bottomFrontRight },
+			{ Set::topFrontLeft, Set::topFrontRight },
+			{ Set::topSideLeft, Set::topSideRight },
+			{ Set::topRearLeft, Set::topRearRight }
+		}};
+
+		/* layout, channel
+		how pairs refer to the channel */
+		juce::String getName(const Set& layout, int channel)
+		{
+			if (layout.isDiscreteLayout())
+				return juce::String(channel + 1);
+			return Set::getAbbreviatedChannelTypeName(layout.getTypeOfChannel(channel));
+		}
+
+		/* layout, name
+		the channel's index, -1 if the layout doesn't have it */
+		int getChannel(const Set& layout, const juce::String& name)
+		{
+			if (name.containsOnly("0123456789"))
+			{
+				const auto channel = name.getIntValue() - 1;
+				return channel >= 0 && channel < layout.size() ? channel : -1;
+			}
+			const auto type = Set::getChannelTypeFromAbbreviation(name);
+			return type == Set::unknown ? -1 : layout.getChannelIndexForType(type);
+		}
+	}
+
+	ChannelPairs::ChannelPairs() :
+		pairs()
+	{}
+
+	juce::String ChannelPairs::getDefault(const juce::AudioChannelSet& layout)
+	{
+		juce::StringArray names;
+		if (layout.isDiscreteLayout())
+			for (auto ch = 0; ch + 1 < layout.size(); ch += 2)
+				names.add(getName(layout, ch) + " " + getName(layout, ch + 1));
+		else
+			for (const auto& counterpart : Counterparts)
+			{
+				const auto left = layout.getChannelIndexForType(counterpart[0]);
+				const auto right = layout.getChannelIndexForType(counterpart[1]);
+				if (left >= 0 && right >= 0)
+					names.add(getName(layout, left) + " " + getName(layout, right));
+			}
+		return names.joinIntoString(", ");
+	}
+
+	void ChannelPairs::set(const juce::AudioChannelSet& layout, const juce::String& text)
+	{
+		pairs.clear();
+		parse(layout, text);
+		if (pairs.empty())
+			parse(layout, getDefault(layout));
+	}
+
+	int ChannelPairs::size() const noexcept
+	{
+		return static_cast<int>(pairs.size());
+	}
+
+	const ChannelPairs::Pair& ChannelPairs::operator[](int i) const noexcept
+	{
+		return pairs[i];
+	}
+
+	void ChannelPairs::parse(const juce::AudioChannelSet& layout, const juce::String& text)
+	{
+		std::vector<bool> paired(static_cast<size_t>(layout.size()), false);
+		for (const auto& item : juce::StringArray::fromTokens(text, ",", ""))
+		{
+			const auto names = juce::StringArray::fromTokens(item, false);
+			if (names.size() != 2)
+				continue;
+			const Pair pair = { getChannel(layout, names[0]), getChannel(layout, names[1]) };
+			if (pair[0] < 0 || pair[1] < 0 || pair[0] == pair[1] || paired[pair[0]] || paired[pair[1]])
+				continue;
+			paired[pair[0]] = paired[pair[1]] = true;
+			pairs.push_back(pair);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <vector>
+
+namespace dsp
+{
+	/*
+	which channels of a bus are widened together, each pair by its own AllHaasXFade.
+	channels that aren't part of a pair, like the centre and the lfe, pass through.
+	pairs are written like "L R, Ls Rs, Ltf Rtf", with juce's abbreviated channel names,
+	or with 1-based channel numbers, which is what discrete layouts go by
+	*/
+	struct ChannelPairs
+	{
+		using Pair = std::array<int, 2>;
+
+		ChannelPairs();
+
+		/* layout
+		every left channel of the layout with its right counterpart, front to back and bottom to top.
+		consecutive channels of discrete layouts */
+		static juce::String getDefault(const juce::AudioChannelSet&);
+
+		/* layout, pairs
+		the pairs the layout has, the default ones if that's none of them.
+		channels that are already part of a pair or that the layout doesn't have are skipped */
+		void set(const juce::AudioChannelSet&, const juce::String&);
+
+		int size() const noexcept;
+
+		/* i */
+		const Pair& operator[](int) const noexcept;
+
+	private:
+		std::vector<Pair> pairs;
+
+		/* layout, pairs */
+		void parse(const juce::AudioChannelSet&, const juce::String&);
+	};
+}
\ No newline at end of file
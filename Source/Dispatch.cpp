@@ -0,0 +1,32 @@
+#include "Dispatch.h"
+#include <juce_core/juce_core.h>
+
+namespace dsp
+{
+	Isa getNativeIsa() noexcept
+	{
+#if ALLHAAS_X86 && ALLHAAS_SSE2
+		if (juce::SystemStats::hasAVX512F())
+			return Isa::AVX512;
+		if (juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3())
+			return Isa::AVX2;
+#endif
+		return Isa::SSE2;
+	}
+
+	template<typename Float>
+	const Kernels<Float>& getKernels(Isa isa) noexcept
+	{
+		switch (isa)
+		{
+#if ALLHAAS_X86 && ALLHAAS_SSE2
+		case Isa::AVX512: return isa_avx512::getKernels<Float>();
+		case Isa::AVX2: return isa_avx2::getKernels<Float>();
+#endif
+		default: return isa_sse2::getKernels<Float>();
+		}
+	}
+
+	template const Kernels<float>& getKernels<float>(Isa) noexcept;
+	template const Kernels<double>& getKernels<double>(Isa) noexcept;
+}
\ No newline at end of file
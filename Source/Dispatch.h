@@ -0,0 +1,122 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ALLHAAS_X86 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ALLHAAS_SSE2 1
+#endif
+
+namespace dsp
+{
+	template<typename Float>
+	struct AllpassBlockStateSpace;
+
+	/*
+	instruction sets the vector kernels are compiled for (see AllpassKernels.h).
+	SSE2 is the build's baseline, which is scalar where SSE2 doesn't exist
+	*/
+	enum class Isa
+	{
+		SSE2,
+		AVX2,
+		AVX512,
+		NumIsas
+	};
+
+	/* the widest Isa both this cpu and this build support */
+	Isa getNativeIsa() noexcept;
+
+	/* widest vector of all Isas, in bytes */
+	static constexpr int MaxVectorBytes = 64;
+
+	/*
+	one Isa's build of the vector kernels
+	*/
+	template<typename Float>
+	struct Kernels
+	{
+		using Wavefront = int(*)(Float*, int, Float, Float, Float*, Float*, int) noexcept;
+		using StateSpace = void(*)(Float*, int, const AllpassBlockStateSpace<Float>&,
+			Float, Float, Float*, Float*, int) noexcept;
+		using LanesStage = void(*)(Float*, int, int, const Float*, const Float*, const Float*,
+			int, bool, Float*, Float*) noexcept;
+		using Multiply = void(*)(Float*, const Float*, const Float*, int) noexcept;
+		using FadeCurve = void(*)(Float*, int, bool) noexcept;
+		using EncodeMidSide = void(*)(Float*, Float*, int) noexcept;
+		using DecodeOutput = int(*)(Float*, Float*, int, bool, bool) noexcept;
+		using MaxSquare = Float(*)(const Float*, int) noexcept;
+		using Fir = void(*)(Float*, const Float*, const Float*, int, int) noexcept;
+		using ComplexMultiplyAdd = void(*)(Float*, Float*, const Float*, const Float*,
+			const Float*, const Float*, int) noexcept;
+		using Butterflies = void(*)(Float*, Float*, const Float*, const Float*, int, int) noexcept;
+
+		int vectorWidth;
+
+		/* smpls, numSamples, a0, a1, z1, z2, numFilters
+		runs the cascade's leading stages as a wavefront, returns how many it processed */
+		Wavefront wavefront;
+
+		/* smpls, numSamples, stateSpace, a0, a1, z1, z2, numFilters */
+		StateSpace stateSpace;
+
+		/* interleaved samples, numRegs, numSamples, a0, a1, numStages, stage, masked, z1, z2
+		one stage of AllpassSlopeLanes, lanes are interleaved with a stride of numRegs * vectorWidth */
+		LanesStage lanesStage;
+
+		/* dest, src, gain, numSamples: dest = src * gain */
+		Multiply multiply;
+
+		/* dest, src, gain, numSamples: dest += src * gain */
+		Multiply addWithMultiply;
+
+		/* gains, numSamples, constantPower
+		turns linear fade positions (0 to 1) into raised cosine, or equal power sine, gains in place */
+		FadeCurve fadeCurve;
+
+		/* left, right, numSamples: left = (left + right) / 2, right = (left - right) / 2 */
+		EncodeMidSide encodeMidSide;
+
+		/* left, right, numSamples, midSide, mono
+		the output stage in one pass: decodes mid / side, then folds to mono, as enabled.
+		returns the first sample at which either channel is the loudest (below 2^24 samples) */
+		DecodeOutput decodeOutput;
+
+		/* smpls, numSamples: the largest square of them, 0 if there are none */
+		MaxSquare maxSquare;
+
+		/* dest, src, taps, numTaps, numSamples: dest[s] += sum of taps[t] * src[s - t]
+		src[-(numTaps - 1)] to src[-1] must be valid history */
+		Fir fir;
+
+		/* accRe, accIm, xRe, xIm, hRe, hIm, numBins: acc += x * h, complex */
+		ComplexMultiplyAdd complexMultiplyAdd;
+
+		/* re, im, wRe, wIm, size, halfLen
+		one radix-2 pass of a complex fft over size bins, halfLen twiddles per group */
+		Butterflies butterflies;
+	};
+
+	/* isa */
+	template<typename Float>
+	const Kernels<Float>& getKernels(Isa) noexcept;
+
+	namespace isa_sse2
+	{
+		template<typename Float>
+		const Kernels<Float>& getKernels() noexcept;
+	}
+
+	namespace isa_avx2
+	{
+		template<typename Float>
+		const Kernels<Float>& getKernels() noexcept;
+	}
+
+	namespace isa_avx512
+	{
+		template<typename Float>
+		const Kernels<Float>& getKernels() noexcept;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "ParamSnapshot.h"
+#include <cmath>
+
+namespace param
+{
+	Snapshot::Snapshot(juce::AudioProcessorValueTreeState& _apvts) :
+		apvts(_apvts),
+		ids(),
+		denormalised(),
+		dirty(All),
+		values()
+	{
+		for (auto i = 0; i < NumParams; ++i)
+		{
+			ids[i] = toID(static_cast<PID>(i));
+			denormalised[i].store(apvts.getRawParameterValue(ids[i])->load());
+			apvts.addParameterListener(ids[i], this);
+		}
+	}
+
+	Snapshot::~Snapshot()
+	{
+		for (auto i = 0; i < NumParams; ++i)
+			apvts.removeParameterListener(ids[i], this);
+	}
+
+	Snapshot::Mask Snapshot::update() noexcept
+	{
+		if (dirty.load(std::memory_order_relaxed) == 0)
+			return 0;
+		const auto changed = dirty.exchange(0, std::memory_order_acquire);
+
+		const auto load = [&](PID pID)
+		{
+			return denormalised[static_cast<int>(pID)].load(std::memory_order_relaxed);
+		};
+
+		if (changed & Cutoff)
+		{
+			values.cutoffLeft = static_cast<double>(load(PID::CutoffLM));
+			values.cutoffRight = static_cast<double>(load(PID::CutoffRS));
+		}
+		if (changed & Feedback)
+		{
+			values.feedbackLeftHz = static_cast<double>(load(PID::FeedbackLM));
+			values.feedbackRightHz = static_cast<double>(load(PID::FeedbackRS));
+		}
+		if (changed & Distance)
+		{
+			values.numFiltersLeft = static_cast<int>(std::round(load(PID::DistanceLM)));
+			values.numFiltersRight = static_cast<int>(std::round(load(PID::DistanceRS)));
+		}
+		if (changed & Output)
+		{
+			values.midSide = load(PID::StereoConfig) > .5f;
+			values.mono = load(PID::Mono) > .5f;
+		}
+		return changed;
+	}
+
+	const Snapshot::Values& Snapshot::get() const noexcept
+	{
+		return values;
+	}
+
+	void Snapshot::parameterChanged(const String& id, float newValue)
+	{
+		for (auto i = 0; i < NumParams; ++i)
+			if (id == ids[i])
+			{
+				denormalised[i].store(newValue, std::memory_order_relaxed);
+				dirty.fetch_or(toBit(static_cast<PID>(i)), std::memory_order_release);
+				return;
+			}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "Param.h"
+
+namespace param
+{
+	/* pID
+	the parameter's bit in a Snapshot::Mask */
+	constexpr std::uint32_t toBit(PID pID) noexcept
+	{
+		return std::uint32_t(1) << static_cast<int>(pID);
+	}
+
+	/*
+	the denormalised parameter values the audio thread works with.
+	the apvts tells it about every change (on whichever thread it happens on),
+	it keeps the value and sets the parameter's bit in an atomic dirty mask,
+	so a block without any changes costs a single atomic load and no range conversions
+	*/
+	struct Snapshot :
+		public juce::AudioProcessorValueTreeState::Listener
+	{
+		using Mask = std::uint32_t;
+		static_assert(NumParams <= 32);
+
+		// groups of parameters that are consumed together
+		static constexpr Mask Distance = toBit(PID::DistanceLM) | toBit(PID::DistanceRS);
+		static constexpr Mask Cutoff = toBit(PID::CutoffLM) | toBit(PID::CutoffRS);
+		static constexpr Mask Feedback = toBit(PID::FeedbackLM) | toBit(PID::FeedbackRS);
+		static constexpr Mask Tuning = Distance | Cutoff | Feedback;
+		static constexpr Mask Output = toBit(PID::StereoConfig) | toBit(PID::Mono);
+		static constexpr Mask All = (Mask(1) << NumParams) - 1;
+
+		struct Values
+		{
+			double cutoffLeft, cutoffRight, feedbackLeftHz, feedbackRightHz;
+			int numFiltersLeft, numFiltersRight;
+			bool midSide, mono;
+		};
+
+		/* apvts
+		starts out with all parameters dirty */
+		Snapshot(juce::AudioProcessorValueTreeState&);
+
+		~Snapshot() override;
+
+		/* audio thread: takes over whatever changed since the last call.
+		returns the bits of the parameters that changed, 0 if values is as it was */
+		Mask update() noexcept;
+
+		const Values& get() const noexcept;
+
+	private:
+		juce::AudioProcessorValueTreeState& apvts;
+		// so listener callbacks on the audio thread don't build strings
+		std::array<String, NumParams> ids;
+		std::array<std::atomic<float>, NumParams> denormalised;
+		std::atomic<Mask> dirty;
+		Values values;
+
+		void parameterChanged(const String&, float) override;
+	};
+}
\ No newline at end of file
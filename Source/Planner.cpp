@@ -0,0 +1,299 @@
+#include "Planner.h"
+#include <type_traits>
+#include <limits>
+#include <vector>
+#include <memory>
+
+namespace dsp
+{
+	namespace
+	{
+		static constexpr int NumRuns = 8;
+
+		/* process, numSamples
+		the first run only warms up the caches, the fastest of the others counts.
+		returns seconds per sample */
+		template<typename Process>
+		double time(Process&& process, int numSamples)
+		{
+			auto ticks = std::numeric_limits<juce::int64>::max();
+			for (auto r = 0; r <= NumRuns; ++r)
+			{
+				const auto start = juce::Time::getHighResolutionTicks();
+				process();
+				const auto elapsed = juce::Time::getHighResolutionTicks() - start;
+				if (r != 0)
+					ticks = std::min(ticks, elapsed);
+			}
+			return juce::Time::highResolutionTicksToSeconds(ticks) / static_cast<double>(numSamples);
+		}
+
+		/* process, numSamples, numBlocks
+		like time(), for processes that cost more on some blocks than on others:
+		each run times numBlocks consecutive blocks and keeps the slowest one */
+		template<typename Process>
+		double timeWorst(Process&& process, int numSamples, int numBlocks)
+		{
+			auto ticks = std::numeric_limits<juce::int64>::max();
+			for (auto r = 0; r <= NumRuns; ++r)
+			{
+				juce::int64 worst = 0;
+				for (auto b = 0; b < numBlocks; ++b)
+				{
+					const auto start = juce::Time::getHighResolutionTicks();
+					process();
+					worst = std::max(worst, juce::Time::getHighResolutionTicks() - start);
+				}
+				if (r != 0)
+					ticks = std::min(ticks, worst);
+			}
+			return juce::Time::highResolutionTicksToSeconds(ticks) / static_cast<double>(numSamples);
+		}
+
+		/* identifies this cpu and the isas it runs, so a settings file
+		shared between machines never hands out another cpu's plan */
+		juce::String getCpuId()
+		{
+			const auto cpu = juce::SystemStats::getCpuVendor() + " " + juce::SystemStats::getCpuModel()
+				+ " " + juce::String(static_cast<int>(getNativeIsa()));
+			return juce::String::toHexString(cpu.hashCode64());
+		}
+
+		int encode(AllpassSlopeKernel kernel, Isa isa) noexcept
+		{
+			return static_cast<int>(kernel) * static_cast<int>(Isa::NumIsas) + static_cast<int>(isa);
+		}
+
+		/* code, kernel, isa
+		returns false if the code isn't a plan this build can run on this cpu */
+		bool decode(int code, AllpassSlopeKernel& kernel, Isa& isa) noexcept
+		{
+			static constexpr auto NumIsas = static_cast<int>(Isa::NumIsas);
+			static constexpr auto NumKernels = static_cast<int>(AllpassSlopeKernel::NumKernels);
+			if (code < 0 || code >= NumKernels * NumIsas)
+				return false;
+			if (code % NumIsas > static_cast<int>(getNativeIsa()))
+				return false;
+			kernel = static_cast<AllpassSlopeKernel>(code / NumIsas);
+			isa = static_cast<Isa>(code % NumIsas);
+			return true;
+		}
+	}
+
+	template<typename Float>
+	KernelPlanner<Float>::KernelPlanner() :
+		choices(),
+		convolutionCosts(),
+		lanesCosts(),
+		blockSize(0)
+	{
+		choices.fill({ Kernel::StageMajor, Isa::SSE2, 0. });
+		convolutionCosts.fill(std::numeric_limits<double>::infinity());
+		lanesCosts.fill(std::numeric_limits<double>::infinity());
+	}
+
+	template<typename Float>
+	void KernelPlanner<Float>::prepare(int _blockSize, juce::PropertiesFile* settings)
+	{
+		// the cpu can't change while the plugin is loaded
+		if (blockSize == _blockSize)
+			return;
+		blockSize = _blockSize;
+
+		const juce::String precision = std::is_same<Float, float>::value ? "Float" : "Double";
+		const auto prefix = "kernelPlan" + precision + "_" + getCpuId() + "_" + juce::String(blockSize) + "_";
+
+		for (auto b = 0; b < NumBuckets; ++b)
+		{
+			const auto key = prefix + juce::String(b);
+			const auto costKey = key + "_cost";
+			auto& choice = choices[b];
+			if (settings != nullptr && decode(settings->getIntValue(key, -1), choice.kernel, choice.isa))
+			{
+				choice.cost = settings->getDoubleValue(costKey, 0.);
+				if (choice.cost > 0.)
+					continue;
+			}
+			choice = measure(b, blockSize);
+			if (settings != nullptr)
+			{
+				settings->setValue(key, encode(choice.kernel, choice.isa));
+				settings->setValue(costKey, choice.cost);
+			}
+		}
+
+		const auto convolutionPrefix = "convolutionCost" + precision + "_" + getCpuId() + "_" + juce::String(blockSize) + "_";
+		for (auto i = 0; i < NumConvolutionSizes; ++i)
+		{
+			const auto key = convolutionPrefix + juce::String(i);
+			auto& cost = convolutionCosts[i];
+			cost = settings != nullptr ? settings->getDoubleValue(key, 0.) : 0.;
+			if (cost > 0.)
+				continue;
+			cost = measureConvolution(i, blockSize);
+			if (settings != nullptr)
+				settings->setValue(key, cost);
+		}
+
+		const auto lanesPrefix = "lanesCost" + precision + "_" + getCpuId() + "_" + juce::String(blockSize) + "_";
+		for (auto l = 2; l <= NumLanes; ++l)
+		{
+			const auto key = lanesPrefix + juce::String(l);
+			auto& cost = lanesCosts[l];
+			cost = settings != nullptr ? settings->getDoubleValue(key, 0.) : 0.;
+			if (cost > 0.)
+				continue;
+			cost = measureLanes(l, blockSize);
+			if (settings != nullptr)
+				settings->setValue(key, cost);
+		}
+
+		if (settings != nullptr)
+			settings->saveIfNeeded();
+	}
+
+	template<typename Float>
+	const typename KernelPlanner<Float>::Choice& KernelPlanner<Float>::operator()(int numFilters) const noexcept
+	{
+		return choices[juce::jlimit(0, NumBuckets - 1, (numFilters - 1) / BucketSize)];
+	}
+
+	template<typename Float>
+	double KernelPlanner<Float>::getCost(int numFilters) const noexcept
+	{
+		// the cascade's cost is linear in its number of stages
+		const auto bucket = juce::jlimit(0, NumBuckets - 1, (numFilters - 1) / BucketSize);
+		return choices[bucket].cost * static_cast<double>(numFilters) / static_cast<double>((bucket + 1) * BucketSize);
+	}
+
+	template<typename Float>
+	int KernelPlanner<Float>::getMaxConvolutionLength(double cost) const noexcept
+	{
+		// linear in the number of partitions between the measured sizes
+		auto numPartitions = 0;
+		for (auto i = 0; i < NumConvolutionSizes; ++i)
+		{
+			const auto size = 1 << i;
+			if (convolutionCosts[i] >= cost)
+			{
+				if (i != 0)
+				{
+					const auto prevSize = size / 2;
+					const auto frac = (cost - convolutionCosts[i - 1]) / (convolutionCosts[i] - convolutionCosts[i - 1]);
+					numPartitions = prevSize + static_cast<int>(frac * static_cast<double>(size - prevSize));
+				}
+				break;
+			}
+			numPartitions = size;
+		}
+		return numPartitions * AllpassSlopeConvolution<Float>::PartitionSize;
+	}
+
+	template<typename Float>
+	double KernelPlanner<Float>::getLanesCost(int numLanes, int numFilters) const noexcept
+	{
+		// a single lane is just a cascade, which runs best on its own kernel
+		if (numLanes < 2)
+			return std::numeric_limits<double>::infinity();
+		return lanesCosts[std::min(numLanes, NumLanes)] * static_cast<double>(numFilters);
+	}
+
+	template<typename Float>
+	typename KernelPlanner<Float>::Choice KernelPlanner<Float>::measure(int bucket, int numSamples)
+	{
+		const auto nativeIsa = getNativeIsa();
+
+		// the cost doesn't depend on the coefficients, only on the number of stages
+		AllpassSlope<Float> filter;
+		filter.updateParameters(1000., 2., 48000., (bucket + 1) * BucketSize);
+
+		std::vector<Float> noise(numSamples), smpls(numSamples);
+		juce::Random rand(numSamples);
+		for (auto& smpl : noise)
+			smpl = static_cast<Float>(rand.nextFloat() * 2.f - 1.f);
+
+		Choice best{ Kernel::StageMajor, Isa::SSE2, std::numeric_limits<double>::infinity() };
+		for (auto k = 0; k < static_cast<int>(Kernel::NumKernels); ++k)
+			for (auto i = 0; i <= static_cast<int>(nativeIsa); ++i)
+			{
+				Choice choice{ static_cast<Kernel>(k), static_cast<Isa>(i), 0. };
+				// stage-major is the same scalar code on every isa
+				if (choice.kernel == Kernel::StageMajor && choice.isa != Isa::SSE2)
+					continue;
+
+				filter.reset();
+				choice.cost = time([&]()
+				{
+					std::copy(noise.begin(), noise.end(), smpls.begin());
+					filter.process(smpls.data(), numSamples, choice.kernel, choice.isa);
+				}, numSamples);
+
+				if (choice.cost < best.cost)
+					best = choice;
+			}
+		return best;
+	}
+
+	template<typename Float>
+	double KernelPlanner<Float>::measureConvolution(int size, int numSamples)
+	{
+		// any impulse response of the right length will do, the cost doesn't depend on it
+		const auto length = (1 << size) * AllpassSlopeConvolution<Float>::PartitionSize;
+		std::vector<double> impulseResponse(length);
+		juce::Random rand(length);
+		for (auto& h : impulseResponse)
+			h = static_cast<double>(rand.nextFloat() * 2.f - 1.f);
+
+		auto convolution = std::make_unique<AllpassSlopeConvolution<Float>>();
+		convolution->setImpulseResponse(impulseResponse.data(), length);
+
+		std::vector<Float> smpls(numSamples);
+		for (auto& smpl : smpls)
+			smpl = static_cast<Float>(rand.nextFloat() * 2.f - 1.f);
+
+		// blocks shorter than a partition take turns doing its ffts, the cascade costs the same on every block.
+		// the block time is bounded by the one that crosses a partition boundary, so that's the cost
+		const auto isa = getNativeIsa();
+		const auto numBlocks = AllpassSlopeConvolution<Float>::PartitionSize / numSamples + 1;
+		return timeWorst([&]()
+		{
+			convolution->process(smpls.data(), numSamples, isa);
+		}, numSamples, numBlocks);
+	}
+
+	template<typename Float>
+	double KernelPlanner<Float>::measureLanes(int numLanes, int numSamples)
+	{
+		// every lane at full Distance, so none of them is masked out of the trailing stages
+		static constexpr int NumFilters = axiom::NumAllpassFilters;
+		std::array<AllpassSlope<Float>, NumLanes> filters;
+		std::array<AllpassSlope<Float>*, NumLanes> cascades;
+		for (auto l = 0; l < NumLanes; ++l)
+		{
+			filters[l].updateParameters(1000. + 100. * l, 2., 48000., NumFilters);
+			cascades[l] = &filters[l];
+		}
+
+		std::vector<Float> noise(NumLanes * numSamples), smpls(NumLanes * numSamples);
+		std::vector<Float> scratch(AllpassSlopeLanes<Float>::getScratchSize(numSamples));
+		std::array<Float*, NumLanes> lanesSamples;
+		juce::Random rand(numSamples);
+		for (auto& smpl : noise)
+			smpl = static_cast<Float>(rand.nextFloat() * 2.f - 1.f);
+		for (auto l = 0; l < NumLanes; ++l)
+			lanesSamples[l] = &smpls[l * numSamples];
+
+		AllpassSlopeLanes<Float> lanes;
+		lanes.prepare(scratch.data());
+		const auto isa = getNativeIsa();
+		const auto cost = time([&]()
+		{
+			std::copy(noise.begin(), noise.end(), smpls.begin());
+			lanes(cascades.data(), lanesSamples.data(), lanesSamples.data(), numLanes, numSamples, isa);
+		}, numSamples);
+		return cost / static_cast<double>(NumFilters);
+	}
+
+	template struct KernelPlanner<float>;
+	template struct KernelPlanner<double>;
+}
\ No newline at end of file
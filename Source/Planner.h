@@ -0,0 +1,74 @@
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include "AllpassConvolution.h"
+#include "AllpassLanes.h"
+
+namespace dsp
+{
+	/*
+	picks the fastest kernel and isa for AllpassSlope<Float> per Distance bucket
+	by timing every candidate on the real block size.
+	it also times AllpassSlopeConvolution<Float> at a few impulse response lengths,
+	so the two can be weighed against each other in the same units,
+	and AllpassSlopeLanes for every number of lanes, so packing cascades is only chosen where it pays off.
+	plans are cached in the settings file per (cpu, block size, bucket),
+	so each machine measures them only once
+	*/
+	template<typename Float>
+	struct KernelPlanner
+	{
+		using Kernel = AllpassSlopeKernel;
+		static constexpr int BucketSize = 16;
+		static constexpr int NumBuckets = axiom::NumAllpassFilters / BucketSize;
+
+		// impulse response lengths the convolution is timed at, in partitions: 1, 2, 4, ..
+		static constexpr int NumConvolutionSizes = 7;
+		static_assert(1 << (NumConvolutionSizes - 1) == AllpassSlopeConvolution<Float>::MaxPartitions);
+		static constexpr int NumLanes = AllpassSlopeLanes<Float>::NumLanes;
+
+		struct Choice
+		{
+			Kernel kernel;
+			Isa isa;
+			// seconds per sample at the bucket's largest Distance
+			double cost;
+		};
+
+		KernelPlanner();
+
+		/* blockSize, settings (can be nullptr)
+		only plans again if the block size changed */
+		void prepare(int, juce::PropertiesFile*);
+
+		/* numFilters */
+		const Choice& operator()(int) const noexcept;
+
+		/* numFilters: seconds per sample of the planned kernel */
+		double getCost(int) const noexcept;
+
+		/* cost: longest impulse response AllpassSlopeConvolution<Float>
+		convolves for less than cost seconds per sample, 0 if none */
+		int getMaxConvolutionLength(double) const noexcept;
+
+		/* numLanes, numFilters: seconds per sample of running numLanes cascades
+		of up to numFilters stages side by side in AllpassSlopeLanes */
+		double getLanesCost(int, int) const noexcept;
+
+	protected:
+		std::array<Choice, NumBuckets> choices;
+		std::array<double, NumConvolutionSizes> convolutionCosts;
+		// seconds per sample and stage, by number of lanes
+		std::array<double, NumLanes + 1> lanesCosts;
+		int blockSize;
+
+		/* bucket, blockSize */
+		static Choice measure(int, int);
+
+		/* size, blockSize: seconds per sample of convolving 2^size partitions,
+		on the block that crosses a partition boundary */
+		static double measureConvolution(int, int);
+
+		/* numLanes, blockSize: seconds per sample and stage of AllpassSlopeLanes */
+		static double measureLanes(int, int);
+	};
+}
\ No newline at end of file
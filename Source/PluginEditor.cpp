@@ -19,12 +19,14 @@ ALLHaasAudioProcessorEditor::ALLHaasAudioProcessorEditor(ALLHaasAudioProcessor&
 	},
     stereoConfigButton(p, param::PID::StereoConfig),
     monoButton(p, param::PID::Mono),
+    channelPairsEditor(),
     isMidSide(p.params[static_cast<int>(param::PID::StereoConfig)]->getValue() > .5f),
     laf()
 {
     addAndMakeVisible(oscilloscope);
     addAndMakeVisible(stereoConfigButton);
     addAndMakeVisible(monoButton);
+    addChildComponent(channelPairsEditor);
     for(auto& slider: slidersLM)
         addAndMakeVisible(slider);
     for(auto& slider: slidersRS)
@@ -52,6 +54,29 @@ ALLHaasAudioProcessorEditor::ALLHaasAudioProcessorEditor(ALLHaasAudioProcessor&
     stereoConfigButton.setName("sc");
     monoButton.setName("mn");
 
+    channelPairsEditor.setJustification(juce::Justification::centred);
+    channelPairsEditor.setColour(juce::TextEditor::ColourIds::textColourId, juce::Colours::limegreen);
+    channelPairsEditor.setColour(juce::TextEditor::ColourIds::backgroundColourId, juce::Colours::transparentBlack);
+    channelPairsEditor.setColour(juce::TextEditor::ColourIds::outlineColourId, juce::Colours::limegreen.withAlpha(.5f));
+    channelPairsEditor.setColour(juce::TextEditor::ColourIds::focusedOutlineColourId, juce::Colours::limegreen);
+    channelPairsEditor.setTextToShowWhenEmpty("L R, Ls Rs", juce::Colours::limegreen.withAlpha(.5f));
+    channelPairsEditor.setText(audioProcessor.getChannelPairs(), false);
+    channelPairsEditor.setVisible(audioProcessor.getMainBusNumOutputChannels() > 2);
+    // the engines are prepared again for the new pairs, so only actual changes are applied
+    const auto applyChannelPairs = [&]()
+    {
+        const auto pairs = channelPairsEditor.getText().trim();
+        if (pairs != audioProcessor.getChannelPairs())
+            audioProcessor.setChannelPairs(pairs);
+        channelPairsEditor.setText(audioProcessor.getChannelPairs(), false);
+    };
+    channelPairsEditor.onReturnKey = applyChannelPairs;
+    channelPairsEditor.onFocusLost = applyChannelPairs;
+    channelPairsEditor.onEscapeKey = [&]()
+    {
+        channelPairsEditor.setText(audioProcessor.getChannelPairs(), false);
+    };
+
     setLookAndFeel(&laf);
 
     const auto& user = *audioProcessor.props.getUserSettings();
@@ -76,6 +101,15 @@ void ALLHaasAudioProcessorEditor::paint(juce::Graphics& g)
 
 void ALLHaasAudioProcessorEditor::timerCallback()
 {
+    // the layout can change while the editor is open
+    const auto hasPairs = audioProcessor.getMainBusNumOutputChannels() > 2;
+    if (channelPairsEditor.isVisible() != hasPairs)
+    {
+        channelPairsEditor.setVisible(hasPairs);
+        if (!channelPairsEditor.hasKeyboardFocus(false))
+            channelPairsEditor.setText(audioProcessor.getChannelPairs(), false);
+    }
+
     const auto stereoConfig = audioProcessor.params[static_cast<int>(param::PID::StereoConfig)]->getValue() > .5f;
     if (isMidSide != stereoConfig)
     {
@@ -126,6 +160,7 @@ void ALLHaasAudioProcessorEditor::resized()
 
     stereoConfigButton.setBounds(gui::maxQuadIn(buttonArea).toNearestIntEdges());
     monoButton.setBounds(gui::maxQuadIn(buttonArea.withX(buttonArea.getRight())).toNearestIntEdges());
+    channelPairsEditor.setBounds(bounds.withHeight(thicc).withWidth(bounds.getWidth() * .4f).reduced(thicc * .1f).toNearestInt());
 
     const auto sliderWidth = thicc * 2.f;
     const auto sliderWHalf = sliderWidth * .5f;
@@ -157,6 +157,8 @@ struct ALLHaasAudioProcessorEditor :
     std::array<Slider, kNumFilterParametersPerChannel> slidersLM;
     std::array<Slider, kNumFilterParametersPerChannel> slidersRS;
     Button stereoConfigButton, monoButton;
+    // which channels of a surround bus are widened together, hidden on stereo buses
+    juce::TextEditor channelPairsEditor;
     bool isMidSide;
 
     LAF laf;
@@ -24,8 +24,15 @@ ALLHaasAudioProcessor::ALLHaasAudioProcessor()
         apvts.getParameter(param::toID(param::PID::StereoConfig)),
         apvts.getParameter(param::toID(param::PID::Mono))
     },
+    snapshot(apvts),
     allHaas(),
-    oscilloscope()
+    allHaasDouble(),
+    allHaasShared(),
+    allHaasSharedDouble(),
+    channelPairs(),
+    oscilloscope(),
+    nativeKernels(&dsp::getKernels<float>(dsp::Isa::SSE2)),
+    nativeKernelsDouble(&dsp::getKernels<double>(dsp::Isa::SSE2))
 #endif
 {
     juce::PropertiesFile::Options options;
@@ -79,7 +86,20 @@ bool ALLHaasAudioProcessor::isMidiEffect() const
 
 double ALLHaasAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.;
+    const auto getValue = [&](PID pID)
+    {
+        return static_cast<double>(apvts.getRawParameterValue(param::toID(pID))->load());
+    };
+    const auto sampleRate = getSampleRate() > 0. ? getSampleRate() : 44100.;
+    const auto tailLength = dsp::AllHaasXFade<double>::getTailLength
+    (
+        getValue(PID::CutoffLM), getValue(PID::CutoffRS),
+        getValue(PID::FeedbackLM), getValue(PID::FeedbackRS),
+        static_cast<int>(std::round(getValue(PID::DistanceLM))),
+        static_cast<int>(std::round(getValue(PID::DistanceRS))),
+        sampleRate
+    );
+    return tailLength / sampleRate;
 }
 
 int ALLHaasAudioProcessor::getNumPrograms()
@@ -107,23 +127,81 @@ void ALLHaasAudioProcessor::changeProgramName(int, const juce::String&)
 
 void ALLHaasAudioProcessor::prepareToPlay(double sampleRate, int maxBlockSize)
 {
-    allHaas.prepare(sampleRate, maxBlockSize);
+    channelPairs.set(getChannelLayoutOfBus(false, 0), apvts.state.getProperty(ChannelPairsID).toString());
+    const auto isa = dsp::getNativeIsa();
+    nativeKernels = &dsp::getKernels<float>(isa);
+    nativeKernelsDouble = &dsp::getKernels<double>(isa);
+    if (isUsingDoublePrecision())
+    {
+        prepareEngines(allHaasDouble, allHaasSharedDouble, sampleRate, maxBlockSize);
+        allHaasShared.release();
+        allHaas.clear();
+    }
+    else
+    {
+        prepareEngines(allHaas, allHaasShared, sampleRate, maxBlockSize);
+        allHaasSharedDouble.release();
+        allHaasDouble.clear();
+    }
 }
 
-void ALLHaasAudioProcessor::releaseResources()
+template<typename Float>
+void ALLHaasAudioProcessor::prepareEngines(Engines<Float>& engines, typename dsp::AllHaasXFade<Float>::Shared& shared,
+    double sampleRate, int maxBlockSize)
 {
+    // the kernel plans and the float32 accuracy check are measured once for all pairs, one worker serves them all.
+    // the engines are tuned to the current parameters here, so the audio thread doesn't have to
+    shared.prepare(sampleRate, maxBlockSize, props.getUserSettings());
+    snapshot.update();
+    const auto& values = snapshot.get();
+    engines.resize(static_cast<size_t>(channelPairs.size()));
+    for (auto& engine : engines)
+    {
+        if (engine == nullptr)
+            engine = std::make_unique<dsp::AllHaasXFade<Float>>();
+        engine->prepare
+        (
+            shared,
+            values.cutoffLeft, values.cutoffRight,
+            values.feedbackLeftHz, values.feedbackRightHz,
+            values.numFiltersLeft, values.numFiltersRight
+        );
+    }
+    shared.start();
+}
 
+void ALLHaasAudioProcessor::releaseResources()
+{
+    allHaasShared.release();
+    allHaasSharedDouble.release();
 }
 
 bool ALLHaasAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
+    // any layout with at least one pair, the other channels pass through
     const auto mainIn = layouts.getMainInputChannelSet();
     const auto mainOut = layouts.getMainOutputChannelSet();
-    const auto stereo = juce::AudioChannelSet::stereo();
-    return mainIn == mainOut && mainOut == stereo;
+    return mainIn == mainOut && dsp::ChannelPairs::getDefault(mainOut).isNotEmpty();
+}
+
+bool ALLHaasAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
 }
 
 void ALLHaasAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processBlockInternal(buffer, allHaas, *nativeKernels);
+}
+
+void ALLHaasAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processBlockInternal(buffer, allHaasDouble, *nativeKernelsDouble);
+}
+
+template<typename Float>
+void ALLHaasAudioProcessor::processBlockInternal(juce::AudioBuffer<Float>& buffer, Engines<Float>& engines,
+    const dsp::Kernels<Float>& kernels)
 {
     juce::ScopedNoDenormals noDenormals;
     const auto numSamples = buffer.getNumSamples();
@@ -137,63 +215,77 @@ void ALLHaasAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce:
         return;
     auto samples = buffer.getArrayOfWritePointers();
 
-    const auto& cutoffLeftParam = *params[static_cast<int>(PID::CutoffLM)];
-    const auto& cutoffRightParam = *params[static_cast<int>(PID::CutoffRS)];
-
-    const auto& feedbackLeftParam = *params[static_cast<int>(PID::FeedbackLM)];
-    const auto& feedbackRightParam = *params[static_cast<int>(PID::FeedbackRS)];
-
-    const auto& cutoffRange = cutoffLeftParam.getNormalisableRange();
-    const auto& feedbackRange = feedbackLeftParam.getNormalisableRange();
-
-    const auto cutoffLeft = static_cast<double>(cutoffRange.convertFrom0to1(cutoffLeftParam.getValue()));
-    const auto cutoffRight = static_cast<double>(cutoffRange.convertFrom0to1(cutoffRightParam.getValue()));
-    const auto feedbackLeftHz = static_cast<double>(feedbackRange.convertFrom0to1(feedbackLeftParam.getValue()));
-    const auto feedbackRightHz = static_cast<double>(feedbackRange.convertFrom0to1(feedbackRightParam.getValue()));
-
-    const auto& distanceLeftParam = *params[static_cast<int>(PID::DistanceLM)];
-    const auto& distanceRightParam = *params[static_cast<int>(PID::DistanceRS)];
-    const auto& distanceRange = distanceLeftParam.getNormalisableRange();
-    const auto numFiltersLeft = static_cast<int>(std::round(distanceRange.convertFrom0to1(distanceLeftParam.getValue())));
-    const auto numFiltersRight = static_cast<int>(std::round(distanceRange.convertFrom0to1(distanceRightParam.getValue())));
-
-    const auto isMidSide = params[static_cast<int>(PID::StereoConfig)]->getValue() > .5f;
-    if(isMidSide)
-        for(auto s = 0; s < numSamples; ++s)
-		{
-			const auto mid = (samples[0][s] + samples[1][s]) * .5f;
-			const auto side = (samples[0][s] - samples[1][s]) * .5f;
-			samples[0][s] = mid;
-			samples[1][s] = side;
-		}
-
-    allHaas
-    (
-        samples,
-        cutoffLeft, cutoffRight,
-        feedbackLeftHz, feedbackRightHz,
-        numFiltersLeft, numFiltersRight,
-        numSamples
-    );
+    const auto changed = snapshot.update();
+    const auto& values = snapshot.get();
+    const auto numPairs = std::min(channelPairs.size(), static_cast<int>(engines.size()));
+
+    // once every engine has gone quiet, silent blocks are skipped altogether
+    // until the input or the parameters change
+    const auto silence = static_cast<Float>(dsp::AllHaasXFade<Float>::Silence);
+    auto asleep = changed == 0;
+    for (auto p = 0; p < numPairs && asleep; ++p)
+        asleep = engines[p]->isAsleep();
+    if (asleep)
+    {
+        for (auto p = 0; p < numPairs && asleep; ++p)
+            for (const auto ch : channelPairs[p])
+                asleep = asleep && kernels.maxSquare(samples[ch], numSamples) <= silence;
+        if (asleep)
+        {
+            oscilloscope.set(0.f, 0.f);
+            return;
+        }
+    }
 
-    if (isMidSide)
-        for (auto s = 0; s < numSamples; ++s)
-		{
-			const auto mid = samples[0][s];
-			const auto side = samples[1][s];
-			samples[0][s] = mid + side;
-			samples[1][s] = mid - side;
-		}
-
-    const auto& monoParam = *params[static_cast<int>(PID::Mono)];
-    if (monoParam.getValue() > .5f)
-        for (auto s = 0; s < numSamples; ++s)
+    // one chunk at a time, so the matrixing and the mono fold find it in cache after the engine,
+    // and the output stage and the oscilloscope's peak search share a single pass.
+    // every pair gets the chunk before the next one starts, so the whole bus stays in cache
+    static constexpr int ChunkSize = dsp::AllHaasXFade<Float>::BlockSize;
+    for (auto p = 0; p < numPairs; ++p)
+        engines[p]->setNonRealtime(isNonRealtime());
+    auto peak = static_cast<Float>(-1);
+    auto peakLeft = static_cast<Float>(0), peakRight = static_cast<Float>(0);
+    for (auto s0 = 0; s0 < numSamples; s0 += ChunkSize)
+    {
+        const auto chunkSize = std::min(ChunkSize, numSamples - s0);
+        for (auto p = 0; p < numPairs; ++p)
         {
-            const auto mid = (samples[0][s] + samples[1][s]) * .5f;
-            samples[0][s] = samples[1][s] = mid;
+            const auto& pair = channelPairs[p];
+            const std::array<Float*, 2> chunk = { samples[pair[0]] + s0, samples[pair[1]] + s0 };
+            if (values.midSide)
+                kernels.encodeMidSide(chunk[0], chunk[1], chunkSize);
+            // what the engine gets, a mono source is silent on the side channel
+            const std::array<bool, 2> silent =
+            {
+                kernels.maxSquare(chunk[0], chunkSize) <= silence,
+                kernels.maxSquare(chunk[1], chunkSize) <= silence
+            };
+
+            (*engines[p])
+            (
+                chunk.data(), silent.data(),
+                values.cutoffLeft, values.cutoffRight,
+                values.feedbackLeftHz, values.feedbackRightHz,
+                values.numFiltersLeft, values.numFiltersRight,
+                chunkSize
+            );
+
+            // the oscilloscope shows the first pair, usually the front one
+            const auto i = kernels.decodeOutput(chunk[0], chunk[1], chunkSize, values.midSide, values.mono);
+            if (p != 0)
+                continue;
+            const auto left = chunk[0][i], right = chunk[1][i];
+            const auto mag = std::max(left * left, right * right);
+            if (peak < mag)
+            {
+                peak = mag;
+                peakLeft = left;
+                peakRight = right;
+            }
         }
+    }
 
-    oscilloscope(samples, numSamples);
+    oscilloscope.set(static_cast<float>(peakLeft), static_cast<float>(peakRight));
 }
 
 bool ALLHaasAudioProcessor::hasEditor() const
@@ -218,7 +310,33 @@ void ALLHaasAudioProcessor::setStateInformation(const void* data, int sizeInByte
     std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
     if (xmlState.get() != nullptr)
         if (xmlState->hasTagName(apvts.state.getType()))
+        {
+            const auto pairs = apvts.state.getProperty(ChannelPairsID).toString();
             apvts.replaceState(juce::ValueTree::fromXml(*xmlState));
+            if (apvts.state.getProperty(ChannelPairsID).toString() != pairs)
+                updateChannelPairs();
+        }
+}
+
+void ALLHaasAudioProcessor::setChannelPairs(const juce::String& pairs)
+{
+    apvts.state.setProperty(ChannelPairsID, pairs, nullptr);
+    updateChannelPairs();
+}
+
+void ALLHaasAudioProcessor::updateChannelPairs()
+{
+    if (getSampleRate() <= 0. || getBlockSize() <= 0)
+        return;
+    suspendProcessing(true);
+    prepareToPlay(getSampleRate(), getBlockSize());
+    suspendProcessing(false);
+}
+
+juce::String ALLHaasAudioProcessor::getChannelPairs() const
+{
+    const auto pairs = apvts.state.getProperty(ChannelPairsID).toString();
+    return pairs.isNotEmpty() ? pairs : dsp::ChannelPairs::getDefault(getChannelLayoutOfBus(false, 0));
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -1,9 +1,13 @@
 #pragma once
 #include <JuceHeader.h>
 #include "Param.h"
+#include "ParamSnapshot.h"
 #include "AllHaas.h"
+#include "ChannelPairs.h"
 #include "XYOscilloscope.h"
 #include <array>
+#include <memory>
+#include <vector>
 
 struct ALLHaasAudioProcessor  : public juce::AudioProcessor
                             #if JucePlugin_Enable_ARA
@@ -12,6 +16,8 @@ struct ALLHaasAudioProcessor  : public juce::AudioProcessor
 {
     using PID = param::PID;
     using Props = juce::ApplicationProperties;
+    // the state's property that stores the channel pairs
+    static constexpr const char* ChannelPairsID = "channelPairs";
 
     //==============================================================================
     ALLHaasAudioProcessor();
@@ -26,6 +32,8 @@ struct ALLHaasAudioProcessor  : public juce::AudioProcessor
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -50,9 +58,43 @@ struct ALLHaasAudioProcessor  : public juce::AudioProcessor
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    /* pairs
+    which channels of the bus are widened together (see dsp::ChannelPairs).
+    stored with the state. there's an engine per pair, so a prepared processor
+    is prepared again right away, with processing suspended in the meantime */
+    void setChannelPairs(const juce::String&);
+
+    /* the pairs of the current layout */
+    juce::String getChannelPairs() const;
+
     Props props;
     juce::AudioProcessorValueTreeState apvts;
     std::array<juce::RangedAudioParameter*, param::NumParams> params;
-    dsp::AllHaasXFade allHaas;
+    param::Snapshot snapshot;
+    // one engine per channel pair, for the precision the host is using
+    std::vector<std::unique_ptr<dsp::AllHaasXFade<float>>> allHaas;
+    std::vector<std::unique_ptr<dsp::AllHaasXFade<double>>> allHaasDouble;
+    // what the engines of each precision share, its worker stops before the engines go
+    dsp::AllHaasXFade<float>::Shared allHaasShared;
+    dsp::AllHaasXFade<double>::Shared allHaasSharedDouble;
+    dsp::ChannelPairs channelPairs;
     dsp::XYOscilloscope oscilloscope;
+
+private:
+    // the kernels of this cpu, looked up in prepareToPlay so the audio thread never queries it.
+    // sse2 until then, which every cpu it runs on has
+    const dsp::Kernels<float>* nativeKernels;
+    const dsp::Kernels<double>* nativeKernelsDouble;
+
+    /* prepares the engines for the stored channel pairs, if the host has prepared the processor */
+    void updateChannelPairs();
+
+    template<typename Float>
+    using Engines = std::vector<std::unique_ptr<dsp::AllHaasXFade<Float>>>;
+
+    template<typename Float>
+    void prepareEngines(Engines<Float>&, typename dsp::AllHaasXFade<Float>::Shared&, double, int);
+
+    template<typename Float>
+    void processBlockInternal(juce::AudioBuffer<Float>&, Engines<Float>&, const dsp::Kernels<Float>&);
 };
@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+
+namespace dsp
+{
+	/*
+	wait-free hand-over from one writer thread to one reader thread.
+	the buffers themselves live elsewhere, only their indices are passed around:
+	the writer publishes the one it has just filled and gets back the one that was waiting,
+	the reader swaps one it's done with for the waiting one, if that's new.
+	with 3 buffers (or more, if the reader holds several) nobody ever waits
+	or touches a buffer the other side is using
+	*/
+	struct TripleBuffer
+	{
+		TripleBuffer() :
+			waiting(0)
+		{}
+
+		/* idx of the buffer neither side holds */
+		void reset(int idx) noexcept
+		{
+			waiting.store(idx);
+		}
+
+		/* idx of the buffer the writer just filled, returns the one to write to next */
+		int publish(int idx) noexcept
+		{
+			return waiting.exchange(idx | Fresh, std::memory_order_acq_rel) & ~Fresh;
+		}
+
+		/* idx of a buffer the reader is done with
+		returns the freshly published buffer, or -1 if there is none (and idx stays the reader's) */
+		int fetch(int idx) noexcept
+		{
+			// only the reader clears Fresh, so it can't be gone by the time of the exchange
+			if ((waiting.load(std::memory_order_acquire) & Fresh) == 0)
+				return -1;
+			return waiting.exchange(idx, std::memory_order_acq_rel) & ~Fresh;
+		}
+
+	private:
+		static constexpr int Fresh = 1 << 16;
+		std::atomic<int> waiting;
+	};
+}
\ No newline at end of file
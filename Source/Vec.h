@@ -0,0 +1,268 @@
+#pragma once
+
+/*
+included once per instruction set, by AllpassKernels.h only.
+the including translation unit defines ALLHAAS_ISA_AVX512 or ALLHAAS_ISA_AVX2
+(SSE2 otherwise, scalar where that isn't available), ALLHAAS_ISA_NAMESPACE
+and opens the matching target region
+*/
+namespace dsp
+{
+	namespace ALLHAAS_ISA_NAMESPACE
+	{
+		/*
+		thin wrapper around the widest vector of Float the instruction set has
+		masks are all-bits-set lanes, like the native compare results
+		shiftIn(prev, cur) returns { prev[Width - 1], cur[0], .., cur[Width - 2] }
+		*/
+		template<typename Float>
+		struct Vec;
+
+		template<>
+		struct Vec<double>
+		{
+#if defined(ALLHAAS_ISA_AVX512)
+			static constexpr int Width = 8;
+			using Native = __m512d;
+
+			static Vec load(const double* x) noexcept { return { _mm512_loadu_pd(x) }; }
+			static Vec broadcast(double x) noexcept { return { _mm512_set1_pd(x) }; }
+			static Vec zero() noexcept { return { _mm512_setzero_pd() }; }
+			void store(double* x) const noexcept { _mm512_storeu_pd(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm512_add_pd(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm512_sub_pd(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm512_mul_pd(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept
+			{
+				const auto k = _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ);
+				return { _mm512_castsi512_pd(_mm512_maskz_set1_epi64(k, -1)) };
+			}
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept
+			{
+				const auto mi = _mm512_castpd_si512(m.v);
+				return { _mm512_mask_blend_pd(_mm512_test_epi64_mask(mi, mi), b.v, a.v) };
+			}
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept
+			{
+				const auto idx = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 15);
+				return { _mm512_permutex2var_pd(cur.v, idx, prev.v) };
+			}
+			static double last(Vec a) noexcept
+			{
+				return _mm512_cvtsd_f64(_mm512_permutex2var_pd(a.v, _mm512_set1_epi64(7), a.v));
+			}
+#elif defined(ALLHAAS_ISA_AVX2)
+			static constexpr int Width = 4;
+			using Native = __m256d;
+
+			static Vec load(const double* x) noexcept { return { _mm256_loadu_pd(x) }; }
+			static Vec broadcast(double x) noexcept { return { _mm256_set1_pd(x) }; }
+			static Vec zero() noexcept { return { _mm256_setzero_pd() }; }
+			void store(double* x) const noexcept { _mm256_storeu_pd(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm256_add_pd(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm256_sub_pd(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm256_mul_pd(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept { return { _mm256_blendv_pd(b.v, a.v, m.v) }; }
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept
+			{
+				const auto u = _mm256_permute2f128_pd(prev.v, cur.v, 0x21);
+				return { _mm256_shuffle_pd(u, cur.v, 0x5) };
+			}
+			static double last(Vec a) noexcept
+			{
+				const auto hi = _mm256_extractf128_pd(a.v, 1);
+				return _mm_cvtsd_f64(_mm_unpackhi_pd(hi, hi));
+			}
+#elif defined(ALLHAAS_SSE2)
+			static constexpr int Width = 2;
+			using Native = __m128d;
+
+			static Vec load(const double* x) noexcept { return { _mm_loadu_pd(x) }; }
+			static Vec broadcast(double x) noexcept { return { _mm_set1_pd(x) }; }
+			static Vec zero() noexcept { return { _mm_setzero_pd() }; }
+			void store(double* x) const noexcept { _mm_storeu_pd(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm_add_pd(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm_sub_pd(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm_mul_pd(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { _mm_cmplt_pd(a.v, b.v) }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept
+			{
+				return { _mm_or_pd(_mm_and_pd(m.v, a.v), _mm_andnot_pd(m.v, b.v)) };
+			}
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept { return { _mm_shuffle_pd(prev.v, cur.v, 0x1) }; }
+			static double last(Vec a) noexcept { return _mm_cvtsd_f64(_mm_unpackhi_pd(a.v, a.v)); }
+#else
+			static constexpr int Width = 1;
+			using Native = double;
+
+			static Vec load(const double* x) noexcept { return { *x }; }
+			static Vec broadcast(double x) noexcept { return { x }; }
+			static Vec zero() noexcept { return { 0. }; }
+			void store(double* x) const noexcept { *x = v; }
+
+			Vec operator+(Vec b) const noexcept { return { v + b.v }; }
+			Vec operator-(Vec b) const noexcept { return { v - b.v }; }
+			Vec operator*(Vec b) const noexcept { return { v * b.v }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { a.v < b.v ? 1. : 0. }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept { return { m.v != 0. ? a.v : b.v }; }
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec) noexcept { return prev; }
+			static double last(Vec a) noexcept { return a.v; }
+#endif
+
+			Native v;
+		};
+
+		template<>
+		struct Vec<float>
+		{
+#if defined(ALLHAAS_ISA_AVX512)
+			static constexpr int Width = 16;
+			using Native = __m512;
+
+			static Vec load(const float* x) noexcept { return { _mm512_loadu_ps(x) }; }
+			static Vec broadcast(float x) noexcept { return { _mm512_set1_ps(x) }; }
+			static Vec zero() noexcept { return { _mm512_setzero_ps() }; }
+			void store(float* x) const noexcept { _mm512_storeu_ps(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm512_add_ps(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm512_sub_ps(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm512_mul_ps(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept
+			{
+				const auto k = _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ);
+				return { _mm512_castsi512_ps(_mm512_maskz_set1_epi32(k, -1)) };
+			}
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept
+			{
+				const auto mi = _mm512_castps_si512(m.v);
+				return { _mm512_mask_blend_ps(_mm512_test_epi32_mask(mi, mi), b.v, a.v) };
+			}
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept
+			{
+				const auto idx = _mm512_set_epi32(14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 31);
+				return { _mm512_permutex2var_ps(cur.v, idx, prev.v) };
+			}
+			static float last(Vec a) noexcept
+			{
+				return _mm512_cvtss_f32(_mm512_permutex2var_ps(a.v, _mm512_set1_epi32(15), a.v));
+			}
+#elif defined(ALLHAAS_ISA_AVX2)
+			static constexpr int Width = 8;
+			using Native = __m256;
+
+			static Vec load(const float* x) noexcept { return { _mm256_loadu_ps(x) }; }
+			static Vec broadcast(float x) noexcept { return { _mm256_set1_ps(x) }; }
+			static Vec zero() noexcept { return { _mm256_setzero_ps() }; }
+			void store(float* x) const noexcept { _mm256_storeu_ps(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm256_add_ps(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm256_sub_ps(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm256_mul_ps(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept { return { _mm256_blendv_ps(b.v, a.v, m.v) }; }
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept
+			{
+				const auto u = _mm256_permute2f128_ps(prev.v, cur.v, 0x21);
+				const auto t = _mm256_shuffle_ps(u, cur.v, _MM_SHUFFLE(0, 0, 3, 3));
+				return { _mm256_shuffle_ps(t, cur.v, _MM_SHUFFLE(2, 1, 2, 0)) };
+			}
+			static float last(Vec a) noexcept
+			{
+				const auto hi = _mm256_extractf128_ps(a.v, 1);
+				return _mm_cvtss_f32(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(3, 3, 3, 3)));
+			}
+#elif defined(ALLHAAS_SSE2)
+			static constexpr int Width = 4;
+			using Native = __m128;
+
+			static Vec load(const float* x) noexcept { return { _mm_loadu_ps(x) }; }
+			static Vec broadcast(float x) noexcept { return { _mm_set1_ps(x) }; }
+			static Vec zero() noexcept { return { _mm_setzero_ps() }; }
+			void store(float* x) const noexcept { _mm_storeu_ps(x, v); }
+
+			Vec operator+(Vec b) const noexcept { return { _mm_add_ps(v, b.v) }; }
+			Vec operator-(Vec b) const noexcept { return { _mm_sub_ps(v, b.v) }; }
+			Vec operator*(Vec b) const noexcept { return { _mm_mul_ps(v, b.v) }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { _mm_cmplt_ps(a.v, b.v) }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept
+			{
+				return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) };
+			}
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec cur) noexcept
+			{
+				const auto t = _mm_shuffle_ps(prev.v, cur.v, _MM_SHUFFLE(0, 0, 3, 3));
+				return { _mm_shuffle_ps(t, cur.v, _MM_SHUFFLE(2, 1, 2, 0)) };
+			}
+			static float last(Vec a) noexcept
+			{
+				return _mm_cvtss_f32(_mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 3, 3, 3)));
+			}
+#else
+			static constexpr int Width = 1;
+			using Native = float;
+
+			static Vec load(const float* x) noexcept { return { *x }; }
+			static Vec broadcast(float x) noexcept { return { x }; }
+			static Vec zero() noexcept { return { 0.f }; }
+			void store(float* x) const noexcept { *x = v; }
+
+			Vec operator+(Vec b) const noexcept { return { v + b.v }; }
+			Vec operator-(Vec b) const noexcept { return { v - b.v }; }
+			Vec operator*(Vec b) const noexcept { return { v * b.v }; }
+
+			/* a, b */
+			static Vec lessThan(Vec a, Vec b) noexcept { return { a.v < b.v ? 1.f : 0.f }; }
+			/* mask, a, b: a where mask is set, b elsewhere */
+			static Vec select(Vec m, Vec a, Vec b) noexcept { return { m.v != 0.f ? a.v : b.v }; }
+
+			/* prev, cur */
+			static Vec shiftIn(Vec prev, Vec) noexcept { return prev; }
+			static float last(Vec a) noexcept { return a.v; }
+#endif
+
+			Native v;
+		};
+
+		using VecD = Vec<double>;
+		using VecF = Vec<float>;
+	}
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <array>
+#include "Dispatch.h"
 
 namespace dsp
 {
@@ -18,23 +19,35 @@ namespace dsp
         return static_cast<Float>(1) / msInSamples(ms, Fs);
     }
 
+    /*
+    ConstantGain (raised cosine) keeps the sum of correlated signals, like two tunings of the same filter, level.
+    ConstantPower (equal power sine) does the same for uncorrelated ones
+    */
+    enum class XFadeCurve
+    {
+        ConstantGain,
+        ConstantPower
+    };
+
     struct XFade
     {
         using AudioBuffer = juce::AudioBuffer<float>;
-        static constexpr float Pi = 3.141592653589f;
 
         XFade() :
             buffer(),
             phase(0.),
             inc(0.),
             idx(0),
+            curve(XFadeCurve::ConstantGain),
+            isa(Isa::SSE2),
             fading(false)
         {}
 
         void prepare(double sampleRate, double lengthMs, int blockSize)
         {
-            buffer.setSize(3, blockSize, false, true, false);
+            buffer.setSize(4, blockSize, false, true, false);
             inc = msInInc(lengthMs, sampleRate);
+            isa = getNativeIsa();
         }
 
         void init() noexcept
@@ -75,38 +88,35 @@ namespace dsp
 
             auto xSamples = getSamples();
             auto xBuf = xSamples[2];
+            auto xBufOut = xSamples[3];
+            for (auto s = 0; s < numSamples; ++s)
+                xBufOut[s] = 1.f - xBuf[s];
+
+            const auto& kernels = getKernels<float>(isa);
+            const auto constantPower = curve == XFadeCurve::ConstantPower;
+            kernels.fadeCurve(xBuf, numSamples, constantPower);
+            kernels.fadeCurve(xBufOut, numSamples, constantPower);
 
             for (auto ch = 0; ch < numChannels; ++ch)
             {
                 auto smpls = samples[ch];
-                const auto xSmpls = xSamples[ch];
-
-                for (auto s = 0; s < numSamples; ++s)
-                {
-                    const auto smpl = smpls[s];
-                    const auto xSmpl = xSmpls[s];
-
-                    const auto xFade = xBuf[s];
-                    const auto xPi = xFade * Pi;
-                    const auto frac = std::cos(xPi + Pi) + 1.f;
-                    const auto xFrac = std::cos(xPi) + 1.f;
-
-                    smpls[s] = (smpl * frac + xSmpl * xFrac) * .5f;
-                }
+                kernels.multiply(smpls, smpls, xBuf, numSamples);
+                kernels.addWithMultiply(smpls, xSamples[ch], xBufOut, numSamples);
             }
         }
 
         AudioBuffer buffer;
         double phase, inc;
         int idx;
+        XFadeCurve curve;
+        Isa isa;
         bool fading;
     };
 
-    template<size_t NumTracks, bool Smooth>
+    template<size_t NumTracks, bool Smooth, typename Float = float>
     struct XFadeMixer
     {
-        using AudioBuffer = juce::AudioBuffer<float>;
-        static constexpr float Pi = 3.141592653589f;
+        using AudioBuffer = juce::AudioBuffer<Float>;
 
         struct Track
         {
@@ -114,6 +124,7 @@ namespace dsp
                 gain(0.f),
                 destGain(0.f),
                 inc(0.f),
+                curve(XFadeCurve::ConstantGain),
                 fading(false)
             {}
 
@@ -137,11 +148,11 @@ namespace dsp
                 return destGain != gain;
             }
 
-            void synthesizeGainValues(float* xBuf, int numSamples) noexcept
+            void synthesizeGainValues(Float* xBuf, int numSamples, const Kernels<Float>& kernels) noexcept
             {
                 if (!isFading())
                 {
-                    SIMD::fill(xBuf, gain, numSamples);
+                    SIMD::fill(xBuf, static_cast<Float>(gain), numSamples);
                     fading = false;
                     return;
                 }
@@ -150,31 +161,32 @@ namespace dsp
                 synthesizeGainValuesInternal(xBuf, numSamples);
 
                 if (Smooth)
-                    makeSmooth(xBuf, numSamples);
+                    kernels.fadeCurve(xBuf, numSamples, curve == XFadeCurve::ConstantPower);
             }
 
-            void copy(float* const* dest, const float* const* src,
-                int numChannels, int numSamples) const noexcept
+            // the gain ramps go through the dispatched kernels, juce's own stop at SSE
+            void copy(Float* const* dest, const Float* const* src,
+                int numChannels, int numSamples, const Kernels<Float>& kernels) const noexcept
             {
                 if (fading)
                 {
                     const auto xBuf = src[2];
                     for (auto ch = 0; ch < numChannels; ++ch)
-                        SIMD::multiply(dest[ch], src[ch], xBuf, numSamples);
+                        kernels.multiply(dest[ch], src[ch], xBuf, numSamples);
                 }
                 else if (gain == 1.)
                     for (auto ch = 0; ch < numChannels; ++ch)
                         SIMD::copy(dest[ch], src[ch], numSamples);
             }
 
-            void add(float* const* dest, const float* const* src,
-                int numChannels, int numSamples) const noexcept
+            void add(Float* const* dest, const Float* const* src,
+                int numChannels, int numSamples, const Kernels<Float>& kernels) const noexcept
             {
                 if (fading)
                 {
                     const auto xBuf = src[2];
                     for (auto ch = 0; ch < numChannels; ++ch)
-                        SIMD::addWithMultiply(dest[ch], src[ch], xBuf, numSamples);
+                        kernels.addWithMultiply(dest[ch], src[ch], xBuf, numSamples);
                 }
                 else if (gain == 1.)
                     for (auto ch = 0; ch < numChannels; ++ch)
@@ -182,10 +194,11 @@ namespace dsp
             }
 
             float gain, destGain, inc;
+            XFadeCurve curve;
         protected:
             bool fading;
 
-            void synthesizeGainValuesInternal(float* xBuf, int numSamples) noexcept
+            void synthesizeGainValuesInternal(Float* xBuf, int numSamples) noexcept
             {
                 if (destGain == 1.f)
                     for (auto s = 0; s < numSamples; ++s)
@@ -214,12 +227,6 @@ namespace dsp
                         }
                     }
             }
-
-            void makeSmooth(float* xBuf, int numSamples) const noexcept
-            {
-                for (auto s = 0; s < numSamples; ++s)
-                    xBuf[s] = std::cos(xBuf[s] * Pi + Pi) * .5f + .5f;
-            }
         };
 
         XFadeMixer() :
@@ -232,13 +239,34 @@ namespace dsp
         void prepare(float sampleRate, float lengthMs, int blockSize)
         {
             buffer.setSize(3 * NumTracks, blockSize, false, true, false);
-            const auto inc = msInInc(lengthMs, sampleRate);
+            prepare(sampleRate, lengthMs);
+        }
+
+        // for callers that apply the gains themselves, getSamples() stays empty
+        void prepare(float sampleRate, float lengthMs)
+        {
+            setLength(sampleRate, lengthMs);
             for (auto& track : tracks)
             {
                 track.gain = 0.f;
-                track.inc = inc;
+                track.disable();
             }
             tracks[idx].gain = 1.f;
+            tracks[idx].enable();
+        }
+
+        // applies from the next init() on, a fade in progress would jump
+        void setLength(float sampleRate, float lengthMs) noexcept
+        {
+            const auto inc = msInInc(lengthMs, sampleRate);
+            for (auto& track : tracks)
+                track.inc = inc;
+        }
+
+        void setCurve(XFadeCurve curve) noexcept
+        {
+            for (auto& track : tracks)
+                track.curve = curve;
         }
 
         void init() noexcept
@@ -249,12 +277,12 @@ namespace dsp
             tracks[idx].enable();
         }
 
-        float* const* getSamples(int i) noexcept
+        Float* const* getSamples(int i) noexcept
         {
             return &buffer.getArrayOfWritePointers()[i * 3];
         }
 
-        const float* const* getSamples(int i) const noexcept
+        const Float* const* getSamples(int i) const noexcept
         {
             return &buffer.getArrayOfReadPointers()[i * 3];
         }
@@ -9,16 +9,26 @@ namespace dsp
 			x(0), y(0)
 		{}
 
-		void operator()(float* const* samples, int numSamples) noexcept
+		template<typename Float>
+		void operator()(Float* const* samples, int numSamples) noexcept
 		{
 			const auto maxIdx = findMax(samples, numSamples);
-			x.store(samples[0][maxIdx]);
-			y.store(samples[1][maxIdx]);
+			x.store(static_cast<float>(samples[0][maxIdx]));
+			y.store(static_cast<float>(samples[1][maxIdx]));
+		}
+
+		/* x, y
+		the loudest stereo sample of a block that was already found elsewhere (see Kernels::decodeOutput) */
+		void set(float _x, float _y) noexcept
+		{
+			x.store(_x);
+			y.store(_y);
 		}
 
 		std::atomic<float> x, y;
 	private:
-		int findMax(float* const* samples, int numSamples) const noexcept
+		template<typename Float>
+		int findMax(Float* const* samples, int numSamples) const noexcept
 		{
 			const auto i0 = findMax(samples[0], numSamples);
 			const auto i1 = findMax(samples[1], numSamples);
@@ -27,7 +37,8 @@ namespace dsp
 			return smpl0 > smpl1 ? i0 : i1;
 		}
 
-		int findMax(float* smpls, int numSamples) const noexcept
+		template<typename Float>
+		int findMax(Float* smpls, int numSamples) const noexcept
 		{
 			auto max = smpls[0] * smpls[0];
 			auto idx = 0;